@@ -0,0 +1,103 @@
+/* src/bench.c
+   Micro-benchmarks for the storage containers. Runs the same workload
+   against each backend and prints timings in milliseconds.
+
+   Usage: ./grade_bench [students]
+*/
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "storage.h"
+#include "threadpool.h"
+
+#define DEFAULT_STUDENTS 100000
+#define RANGE_SCANS 1000
+#define RANGE_WIDTH 100
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static int count_row(const Student *s, void *user) {
+    (void)s;
+    ++*(size_t *)user;
+    return 0;
+}
+
+static void run_backend(StorageBackend b, size_t n) {
+    char name[32];
+    unsigned int seed = 12345;
+
+    init_storage();
+    storage_set_backend(b);
+    storage_set_quiet(1);
+
+    double t0 = now_ms();
+    for (size_t i = 0; i < n; ++i) {
+        snprintf(name, sizeof(name), "Student %zu", i);
+        add_student(name, (double)(rand_r(&seed) % 10000) / 100.0);
+    }
+    double t_add = now_ms() - t0;
+    StorageMemoryStats mem_full;
+    storage_memory_stats(&mem_full);
+
+    t0 = now_ms();
+    size_t hits = 0;
+    for (int i = 0; i < RANGE_SCANS; ++i) {
+        int lo = 1 + rand_r(&seed) % (int)n;
+        storage_range_by_id(lo, lo + RANGE_WIDTH - 1, count_row, &hits);
+    }
+    double t_range = now_ms() - t0;
+
+    t0 = now_ms();
+    size_t scanned = 0;
+    storage_foreach(count_row, &scanned);
+    double t_scan = now_ms() - t0;
+
+    t0 = now_ms();
+    sort_by_name();
+    double t_sort = now_ms() - t0;
+
+    t0 = now_ms();
+    volatile double avg = compute_average();
+    double t_avg = now_ms() - t0;
+    (void)avg;
+
+    /* remove a tenth of the roster from random positions */
+    t0 = now_ms();
+    for (size_t i = 0; i < n / 10; ++i) remove_student(1 + rand_r(&seed) % (int)n);
+    double t_remove = now_ms() - t0;
+    StorageMemoryStats mem_removed, mem_fit;
+    storage_memory_stats(&mem_removed);
+    storage_shrink_to_fit();
+    storage_memory_stats(&mem_fit);
+
+    printf("%-8s add %9.2f  range %9.2f  scan %7.2f  sort %8.2f  avg %6.2f  remove %9.2f  (%zu range hits, %zu left)\n",
+           storage_backend_name(), t_add, t_range, t_scan, t_sort, t_avg, t_remove, hits, get_storage_count());
+    printf("%-8s KiB used/reserved: full %zu/%zu, after removes %zu/%zu, fitted %zu/%zu%s\n",
+           "", mem_full.used_bytes >> 10, mem_full.reserved_bytes >> 10,
+           mem_removed.used_bytes >> 10, mem_removed.reserved_bytes >> 10,
+           mem_fit.used_bytes >> 10, mem_fit.reserved_bytes >> 10,
+           mem_full.huge_pages ? " (huge pages)" : "");
+    (void)scanned;
+
+    free_storage();
+    storage_set_quiet(0);
+}
+
+int main(int argc, char *argv[]) {
+    size_t n = DEFAULT_STUDENTS;
+    if (argc > 1) n = (size_t)strtoul(argv[1], NULL, 10);
+    if (n == 0) n = DEFAULT_STUDENTS;
+
+    printf("Storage benchmark: %zu students, %zu threads, times in ms\n", n, pool_thread_count());
+    run_backend(STORAGE_BACKEND_ARRAY, n);
+    run_backend(STORAGE_BACKEND_BPTREE, n);
+    pool_shutdown();
+    return 0;
+}
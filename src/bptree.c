@@ -0,0 +1,373 @@
+/* src/bptree.c — B+tree of Student records keyed by id.
+
+   Inner nodes keep the invariant
+       ids in child[i] < keys[i] <= ids in child[i+1]
+   and are searched with an upper bound, so a separator may go stale after
+   a delete without breaking lookups. Nodes get one spare slot so an insert
+   can overflow first and split afterwards.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bptree.h"
+
+#define LEAF_MIN (BPT_LEAF_MAX / 2)
+#define INNER_MIN (BPT_INNER_MAX / 2)
+
+typedef struct {
+    int leaf;
+    int n;
+} NodeHead;
+
+typedef struct Leaf {
+    NodeHead h;
+    struct Leaf *prev;
+    struct Leaf *next;
+    Student rec[BPT_LEAF_MAX + 1];
+} Leaf;
+
+typedef struct {
+    NodeHead h;
+    int keys[BPT_INNER_MAX + 1];
+    NodeHead *child[BPT_INNER_MAX + 2];
+} Inner;
+
+struct BPTree {
+    NodeHead *root;
+    size_t size;
+};
+
+static void *xcalloc(size_t n) {
+    void *p = calloc(1, n);
+    if (!p) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
+
+static Leaf *new_leaf(void) {
+    Leaf *l = xcalloc(sizeof(Leaf));
+    l->h.leaf = 1;
+    return l;
+}
+
+static Inner *new_inner(void) {
+    Inner *in = xcalloc(sizeof(Inner));
+    in->h.leaf = 0;
+    return in;
+}
+
+/* First position in the leaf whose id is >= id. */
+static int leaf_lower_bound(const Leaf *l, int id) {
+    int lo = 0, hi = l->h.n;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (l->rec[mid].id < id) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+/* Index of the child that may contain id. */
+static int inner_child_index(const Inner *in, int id) {
+    int lo = 0, hi = in->h.n;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (in->keys[mid] <= id) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+static void free_node(NodeHead *n) {
+    if (!n) return;
+    if (!n->leaf) {
+        Inner *in = (Inner *)n;
+        for (int i = 0; i <= in->h.n; ++i) free_node(in->child[i]);
+    }
+    free(n);
+}
+
+BPTree *bpt_create(void) {
+    return xcalloc(sizeof(BPTree));
+}
+
+void bpt_clear(BPTree *t) {
+    if (!t) return;
+    free_node(t->root);
+    t->root = NULL;
+    t->size = 0;
+}
+
+void bpt_destroy(BPTree *t) {
+    bpt_clear(t);
+    free(t);
+}
+
+size_t bpt_size(const BPTree *t) { return t ? t->size : 0; }
+
+static size_t node_bytes(const NodeHead *n) {
+    if (!n) return 0;
+    if (n->leaf) return sizeof(Leaf);
+    const Inner *in = (const Inner *)n;
+    size_t bytes = sizeof(Inner);
+    for (int i = 0; i <= in->h.n; ++i) bytes += node_bytes(in->child[i]);
+    return bytes;
+}
+
+size_t bpt_memory(const BPTree *t) {
+    return t ? sizeof(BPTree) + node_bytes(t->root) : 0;
+}
+
+static Leaf *find_leaf(const BPTree *t, int id) {
+    NodeHead *n = t->root;
+    if (!n) return NULL;
+    while (!n->leaf) {
+        const Inner *in = (const Inner *)n;
+        n = in->child[inner_child_index(in, id)];
+    }
+    return (Leaf *)n;
+}
+
+static Leaf *leftmost_leaf(const BPTree *t) {
+    NodeHead *n = t->root;
+    if (!n) return NULL;
+    while (!n->leaf) n = ((Inner *)n)->child[0];
+    return (Leaf *)n;
+}
+
+Student *bpt_find(const BPTree *t, int id) {
+    if (!t) return NULL;
+    Leaf *l = find_leaf(t, id);
+    if (!l) return NULL;
+    int pos = leaf_lower_bound(l, id);
+    if (pos < l->h.n && l->rec[pos].id == id) return &l->rec[pos];
+    return NULL;
+}
+
+/* ---- insert ---- */
+
+/* Returns -1 on duplicate, 0 on plain insert, 1 if node split (the new
+   right sibling and its separator are returned through the out params). */
+static int insert_rec(NodeHead *node, const Student *s, int *up_key, NodeHead **up_node) {
+    if (node->leaf) {
+        Leaf *l = (Leaf *)node;
+        int pos = leaf_lower_bound(l, s->id);
+        if (pos < l->h.n && l->rec[pos].id == s->id) return -1;
+        memmove(&l->rec[pos + 1], &l->rec[pos], (size_t)(l->h.n - pos) * sizeof(Student));
+        l->rec[pos] = *s;
+        l->h.n++;
+        if (l->h.n <= BPT_LEAF_MAX) return 0;
+
+        Leaf *r = new_leaf();
+        int keep = l->h.n / 2;
+        r->h.n = l->h.n - keep;
+        memcpy(r->rec, &l->rec[keep], (size_t)r->h.n * sizeof(Student));
+        l->h.n = keep;
+        r->next = l->next;
+        r->prev = l;
+        if (l->next) l->next->prev = r;
+        l->next = r;
+        *up_key = r->rec[0].id;
+        *up_node = &r->h;
+        return 1;
+    }
+
+    Inner *in = (Inner *)node;
+    int idx = inner_child_index(in, s->id);
+    int ck;
+    NodeHead *cn;
+    int res = insert_rec(in->child[idx], s, &ck, &cn);
+    if (res != 1) return res;
+
+    memmove(&in->keys[idx + 1], &in->keys[idx], (size_t)(in->h.n - idx) * sizeof(int));
+    memmove(&in->child[idx + 2], &in->child[idx + 1], (size_t)(in->h.n - idx) * sizeof(NodeHead *));
+    in->keys[idx] = ck;
+    in->child[idx + 1] = cn;
+    in->h.n++;
+    if (in->h.n <= BPT_INNER_MAX) return 0;
+
+    /* split: keys[mid] moves up, the right half goes to a new node */
+    Inner *r = new_inner();
+    int mid = in->h.n / 2;
+    r->h.n = in->h.n - mid - 1;
+    memcpy(r->keys, &in->keys[mid + 1], (size_t)r->h.n * sizeof(int));
+    memcpy(r->child, &in->child[mid + 1], (size_t)(r->h.n + 1) * sizeof(NodeHead *));
+    *up_key = in->keys[mid];
+    *up_node = &r->h;
+    in->h.n = mid;
+    return 1;
+}
+
+int bpt_insert(BPTree *t, const Student *s) {
+    if (!t || !s) return 0;
+    if (!t->root) t->root = &new_leaf()->h;
+
+    int up_key;
+    NodeHead *up_node;
+    int res = insert_rec(t->root, s, &up_key, &up_node);
+    if (res < 0) return 0;
+    if (res == 1) {
+        Inner *root = new_inner();
+        root->h.n = 1;
+        root->keys[0] = up_key;
+        root->child[0] = t->root;
+        root->child[1] = up_node;
+        t->root = &root->h;
+    }
+    t->size++;
+    return 1;
+}
+
+/* ---- remove ---- */
+
+static void inner_drop(Inner *in, int key_idx) {
+    /* remove keys[key_idx] and child[key_idx + 1] */
+    memmove(&in->keys[key_idx], &in->keys[key_idx + 1], (size_t)(in->h.n - key_idx - 1) * sizeof(int));
+    memmove(&in->child[key_idx + 1], &in->child[key_idx + 2], (size_t)(in->h.n - key_idx - 1) * sizeof(NodeHead *));
+    in->h.n--;
+}
+
+static void fix_leaf(Inner *parent, int idx) {
+    Leaf *c = (Leaf *)parent->child[idx];
+    Leaf *left = idx > 0 ? (Leaf *)parent->child[idx - 1] : NULL;
+    Leaf *right = idx < parent->h.n ? (Leaf *)parent->child[idx + 1] : NULL;
+
+    if (left && left->h.n > LEAF_MIN) {
+        memmove(&c->rec[1], &c->rec[0], (size_t)c->h.n * sizeof(Student));
+        c->rec[0] = left->rec[--left->h.n];
+        c->h.n++;
+        parent->keys[idx - 1] = c->rec[0].id;
+        return;
+    }
+    if (right && right->h.n > LEAF_MIN) {
+        c->rec[c->h.n++] = right->rec[0];
+        memmove(&right->rec[0], &right->rec[1], (size_t)(right->h.n - 1) * sizeof(Student));
+        right->h.n--;
+        parent->keys[idx] = right->rec[0].id;
+        return;
+    }
+
+    /* merge the pair (dst, src) where src sits right after dst */
+    Leaf *dst = left ? left : c;
+    Leaf *src = left ? c : right;
+    int key_idx = left ? idx - 1 : idx;
+    if (!src) return; /* only child; parent is the root and will collapse */
+    memcpy(&dst->rec[dst->h.n], src->rec, (size_t)src->h.n * sizeof(Student));
+    dst->h.n += src->h.n;
+    dst->next = src->next;
+    if (src->next) src->next->prev = dst;
+    free(src);
+    inner_drop(parent, key_idx);
+}
+
+static void fix_inner(Inner *parent, int idx) {
+    Inner *c = (Inner *)parent->child[idx];
+    Inner *left = idx > 0 ? (Inner *)parent->child[idx - 1] : NULL;
+    Inner *right = idx < parent->h.n ? (Inner *)parent->child[idx + 1] : NULL;
+
+    if (left && left->h.n > INNER_MIN) {
+        memmove(&c->keys[1], &c->keys[0], (size_t)c->h.n * sizeof(int));
+        memmove(&c->child[1], &c->child[0], (size_t)(c->h.n + 1) * sizeof(NodeHead *));
+        c->keys[0] = parent->keys[idx - 1];
+        c->child[0] = left->child[left->h.n];
+        c->h.n++;
+        parent->keys[idx - 1] = left->keys[left->h.n - 1];
+        left->h.n--;
+        return;
+    }
+    if (right && right->h.n > INNER_MIN) {
+        c->keys[c->h.n] = parent->keys[idx];
+        c->child[c->h.n + 1] = right->child[0];
+        c->h.n++;
+        parent->keys[idx] = right->keys[0];
+        memmove(&right->keys[0], &right->keys[1], (size_t)(right->h.n - 1) * sizeof(int));
+        memmove(&right->child[0], &right->child[1], (size_t)right->h.n * sizeof(NodeHead *));
+        right->h.n--;
+        return;
+    }
+
+    Inner *dst = left ? left : c;
+    Inner *src = left ? c : right;
+    int key_idx = left ? idx - 1 : idx;
+    if (!src) return;
+    dst->keys[dst->h.n] = parent->keys[key_idx];
+    memcpy(&dst->keys[dst->h.n + 1], src->keys, (size_t)src->h.n * sizeof(int));
+    memcpy(&dst->child[dst->h.n + 1], src->child, (size_t)(src->h.n + 1) * sizeof(NodeHead *));
+    dst->h.n += 1 + src->h.n;
+    free(src);
+    inner_drop(parent, key_idx);
+}
+
+static int remove_rec(NodeHead *node, int id) {
+    if (node->leaf) {
+        Leaf *l = (Leaf *)node;
+        int pos = leaf_lower_bound(l, id);
+        if (pos >= l->h.n || l->rec[pos].id != id) return 0;
+        memmove(&l->rec[pos], &l->rec[pos + 1], (size_t)(l->h.n - pos - 1) * sizeof(Student));
+        l->h.n--;
+        return 1;
+    }
+
+    Inner *in = (Inner *)node;
+    int idx = inner_child_index(in, id);
+    NodeHead *c = in->child[idx];
+    if (!remove_rec(c, id)) return 0;
+    if (c->leaf) {
+        if (c->n < LEAF_MIN) fix_leaf(in, idx);
+    } else {
+        if (c->n < INNER_MIN) fix_inner(in, idx);
+    }
+    return 1;
+}
+
+int bpt_remove(BPTree *t, int id) {
+    if (!t || !t->root) return 0;
+    if (!remove_rec(t->root, id)) return 0;
+    t->size--;
+
+    /* collapse an empty root */
+    if (t->root->leaf) {
+        if (t->root->n == 0) {
+            free(t->root);
+            t->root = NULL;
+        }
+    } else if (t->root->n == 0) {
+        NodeHead *only = ((Inner *)t->root)->child[0];
+        free(t->root);
+        t->root = only;
+    }
+    return 1;
+}
+
+/* ---- scans ---- */
+
+size_t bpt_foreach(const BPTree *t, student_visit_fn fn, void *user) {
+    if (!t || !fn) return 0;
+    size_t visited = 0;
+    for (const Leaf *l = leftmost_leaf(t); l; l = l->next) {
+        for (int i = 0; i < l->h.n; ++i) {
+            visited++;
+            if (fn(&l->rec[i], user)) return visited;
+        }
+    }
+    return visited;
+}
+
+size_t bpt_range(const BPTree *t, int lo, int hi, student_visit_fn fn, void *user) {
+    if (!t || !fn || lo > hi) return 0;
+    const Leaf *l = find_leaf(t, lo);
+    if (!l) return 0;
+    size_t visited = 0;
+    int i = leaf_lower_bound(l, lo);
+    for (; l; l = l->next, i = 0) {
+        for (; i < l->h.n; ++i) {
+            if (l->rec[i].id > hi) return visited;
+            visited++;
+            if (fn(&l->rec[i], user)) return visited;
+        }
+    }
+    return visited;
+}
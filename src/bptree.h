@@ -0,0 +1,38 @@
+#ifndef BPTREE_H
+#define BPTREE_H
+
+#include <stddef.h>
+#include "storage.h"
+
+/* B+tree of Student records keyed by id.
+   Leaves hold the records inline and are chained left-to-right, so a full
+   scan or an id range scan is a walk over a few contiguous blocks. */
+
+/* Node widths. A leaf of 32 students is ~3.5 KiB; an inner node of
+   64 keys fits in a handful of cache lines. */
+#define BPT_LEAF_MAX 32
+#define BPT_INNER_MAX 64
+
+typedef struct BPTree BPTree;
+
+BPTree *bpt_create(void);
+void bpt_destroy(BPTree *t);
+void bpt_clear(BPTree *t);
+size_t bpt_size(const BPTree *t);
+/* Bytes allocated for the tree's nodes (walks the tree) */
+size_t bpt_memory(const BPTree *t);
+
+/* Returns 1 if inserted, 0 if a record with the same id already exists. */
+int bpt_insert(BPTree *t, const Student *s);
+/* Returns 1 if removed, 0 if no record with that id exists. */
+int bpt_remove(BPTree *t, int id);
+/* Returns a pointer into the leaf (valid until the next insert/remove) or NULL. */
+Student *bpt_find(const BPTree *t, int id);
+
+/* Visit records in ascending id order. Iteration stops early when fn
+   returns nonzero. Returns the number of records visited. */
+size_t bpt_foreach(const BPTree *t, student_visit_fn fn, void *user);
+/* Visit records with lo <= id <= hi in ascending id order. */
+size_t bpt_range(const BPTree *t, int lo, int hi, student_visit_fn fn, void *user);
+
+#endif /* BPTREE_H */
@@ -0,0 +1,197 @@
+/* src/client.c — blocking client for grade_systemd */
+
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "client.h"
+
+Client *client_connect(const char *socket_path) {
+    struct sockaddr_un addr;
+    if (!socket_path || strlen(socket_path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Invalid socket path\n");
+        return NULL;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return NULL;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socket_path);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        fprintf(stderr, "Cannot connect to %s: %s\n", socket_path, strerror(errno));
+        close(fd);
+        return NULL;
+    }
+    Client *c = calloc(1, sizeof(Client));
+    if (!c) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    c->fd = fd;
+    c->next_seq = 1;
+    return c;
+}
+
+void client_close(Client *c) {
+    if (!c) return;
+    close(c->fd);
+    pbuf_free(&c->in);
+    free(c);
+}
+
+int client_send(Client *c, const ProtoBuf *msg) {
+    size_t off = 0;
+    while (off < msg->len) {
+        ssize_t n = write(c->fd, msg->data + off, msg->len - off);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        off += (size_t)n;
+    }
+    return 0;
+}
+
+int client_recv(Client *c, ProtoHeader *h, ProtoReader *payload) {
+    pbuf_consume(&c->in, c->consumed);
+    c->consumed = 0;
+    for (;;) {
+        if (c->in.len >= PROTO_HEADER_SIZE) {
+            proto_read_header(c->in.data, h);
+            if (h->len > PROTO_MAX_PAYLOAD) return -1;
+            size_t total = PROTO_HEADER_SIZE + h->len;
+            if (c->in.len >= total) {
+                preader_init(payload, c->in.data + PROTO_HEADER_SIZE, h->len);
+                c->consumed = total;
+                return 0;
+            }
+        }
+        pbuf_reserve(&c->in, 64 * 1024);
+        ssize_t n = read(c->fd, c->in.data + c->in.len, c->in.cap - c->in.len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        c->in.len += (size_t)n;
+    }
+}
+
+/* Send one request and wait for its reply */
+static int roundtrip(Client *c, ProtoBuf *req, ProtoHeader *h, ProtoReader *r) {
+    int rc = client_send(c, req);
+    pbuf_free(req);
+    if (rc != 0 || client_recv(c, h, r) != 0) return -1;
+    return 0;
+}
+
+int client_add(Client *c, const char *name, double grade, int *out_id) {
+    ProtoBuf req = {0};
+    size_t m = proto_begin_message(&req, OP_ADD, 0, c->next_seq++);
+    pbuf_put_f64(&req, grade);
+    pbuf_put_str(&req, name);
+    proto_end_message(&req, m);
+
+    ProtoHeader h;
+    ProtoReader r;
+    if (roundtrip(c, &req, &h, &r) != 0) return -1;
+    int32_t id = preader_i32(&r);
+    if (h.status == STATUS_OK && out_id) *out_id = id;
+    return h.status;
+}
+
+int client_remove(Client *c, int id) {
+    ProtoBuf req = {0};
+    size_t m = proto_begin_message(&req, OP_REMOVE, 0, c->next_seq++);
+    pbuf_put_i32(&req, id);
+    proto_end_message(&req, m);
+
+    ProtoHeader h;
+    ProtoReader r;
+    if (roundtrip(c, &req, &h, &r) != 0) return -1;
+    return h.status;
+}
+
+int client_stats(Client *c, size_t *count, double *average) {
+    ProtoBuf req = {0};
+    size_t m = proto_begin_message(&req, OP_STATS, 0, c->next_seq++);
+    proto_end_message(&req, m);
+
+    ProtoHeader h;
+    ProtoReader r;
+    if (roundtrip(c, &req, &h, &r) != 0) return -1;
+    uint32_t n = preader_u32(&r);
+    double avg = preader_f64(&r);
+    if (count) *count = n;
+    if (average) *average = avg;
+    return h.status;
+}
+
+int client_list_page(Client *c, size_t offset, size_t limit,
+                     Student *out, size_t *n, size_t *total, uint32_t *generation) {
+    ProtoBuf req = {0};
+    size_t m = proto_begin_message(&req, OP_LIST_PAGE, 0, c->next_seq++);
+    pbuf_put_u32(&req, (uint32_t)offset);
+    pbuf_put_u32(&req, (uint32_t)limit);
+    proto_end_message(&req, m);
+
+    ProtoHeader h;
+    ProtoReader r;
+    if (roundtrip(c, &req, &h, &r) != 0) return -1;
+    uint32_t gen = preader_u32(&r);
+    uint32_t all = preader_u32(&r);
+    uint32_t got = preader_u32(&r);
+    if (got > limit) got = (uint32_t)limit;
+    for (uint32_t i = 0; i < got; ++i) preader_student(&r, &out[i]);
+    if (r.err) return STATUS_BAD_REQUEST;
+    if (n) *n = got;
+    if (total) *total = all;
+    if (generation) *generation = gen;
+    return h.status;
+}
+
+int client_search(Client *c, const char *needle, size_t limit, Student *out, size_t *n) {
+    ProtoBuf req = {0};
+    size_t m = proto_begin_message(&req, OP_SEARCH, 0, c->next_seq++);
+    pbuf_put_u32(&req, (uint32_t)limit);
+    pbuf_put_str(&req, needle);
+    proto_end_message(&req, m);
+
+    ProtoHeader h;
+    ProtoReader r;
+    if (roundtrip(c, &req, &h, &r) != 0) return -1;
+    uint32_t got = preader_u32(&r);
+    if (got > limit) got = (uint32_t)limit;
+    for (uint32_t i = 0; i < got; ++i) preader_student(&r, &out[i]);
+    if (r.err) return STATUS_BAD_REQUEST;
+    if (n) *n = got;
+    return h.status;
+}
+
+int client_sort(Client *c, int order) {
+    ProtoBuf req = {0};
+    size_t m = proto_begin_message(&req, OP_SORT, 0, c->next_seq++);
+    pbuf_put_u8(&req, (uint8_t)order);
+    proto_end_message(&req, m);
+
+    ProtoHeader h;
+    ProtoReader r;
+    if (roundtrip(c, &req, &h, &r) != 0) return -1;
+    return h.status;
+}
+
+int client_save(Client *c) {
+    ProtoBuf req = {0};
+    size_t m = proto_begin_message(&req, OP_SAVE, 0, c->next_seq++);
+    proto_end_message(&req, m);
+
+    ProtoHeader h;
+    ProtoReader r;
+    if (roundtrip(c, &req, &h, &r) != 0) return -1;
+    return h.status;
+}
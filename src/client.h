@@ -0,0 +1,40 @@
+#ifndef CLIENT_H
+#define CLIENT_H
+
+/* Blocking client for grade_systemd. The synchronous calls send one
+   request and wait for its reply; client_send/client_recv expose the raw
+   framing for callers that pipeline (see loadgen.c). */
+
+#include <stddef.h>
+#include "protocol.h"
+
+typedef struct {
+    int fd;
+    uint32_t next_seq;
+    ProtoBuf in;       /* bytes received but not yet returned */
+    size_t consumed;   /* size of the frame handed out by the last recv */
+} Client;
+
+/* Returns NULL (and prints why) if the daemon is not reachable */
+Client *client_connect(const char *socket_path);
+void client_close(Client *c);
+
+/* Write a complete buffer of encoded requests; 0 on success, -1 on error */
+int client_send(Client *c, const ProtoBuf *msg);
+/* Wait for the next reply. The payload reader stays valid until the next
+   call. Returns 0 on success, -1 if the connection failed. */
+int client_recv(Client *c, ProtoHeader *h, ProtoReader *payload);
+
+/* Synchronous requests: return a STATUS_* value, or -1 if the
+   connection failed. */
+int client_add(Client *c, const char *name, double grade, int *out_id);
+int client_remove(Client *c, int id);
+int client_stats(Client *c, size_t *count, double *average);
+/* out must hold `limit` records; generation may be NULL */
+int client_list_page(Client *c, size_t offset, size_t limit,
+                     Student *out, size_t *n, size_t *total, uint32_t *generation);
+int client_search(Client *c, const char *needle, size_t limit, Student *out, size_t *n);
+int client_sort(Client *c, int order);
+int client_save(Client *c);
+
+#endif /* CLIENT_H */
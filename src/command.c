@@ -0,0 +1,397 @@
+/* src/command.c — batched edits with an undo/redo log */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "command.h"
+#include "gradebook.h"
+
+/* Batches kept for undo; older ones are dropped */
+#define HISTORY_DEPTH 32
+#define NO_ROW SIZE_MAX
+
+/* A history entry holds the rows that take storage back to the state
+   before a batch (undo) or forward again (redo), as a merge. Students the
+   rows bring back return to their old position in the array and get
+   their assessment scores back. Score and weight edits are recorded by
+   their old values; finals are recomputed from them. */
+typedef struct {
+    int id;       /* 0 for the weight of assessment k */
+    size_t k;
+    double value; /* NAN clears a score */
+} GradeEdit;
+
+typedef struct {
+    StudentDelta *rows;
+    size_t n;
+    size_t *pos;      /* position per row, NO_ROW to append; NULL if none */
+    size_t ncols;     /* assessments when recorded */
+    double *scores;   /* n * ncols, NAN when missing; NULL if none */
+    GradeEdit *edits; /* applied in order, before the rows */
+    size_t nedits;
+} Batch;
+
+static StudentDelta *queue = NULL;
+static size_t queued = 0;
+static size_t queue_cap = 0;
+static int queue_next_id = 0; /* next id for a queued add */
+static GradeEdit *edit_queue = NULL;
+static size_t edits_queued = 0;
+static size_t edit_cap = 0;
+
+static Batch undo_log[HISTORY_DEPTH];
+static size_t undo_len = 0;
+static Batch redo_log[HISTORY_DEPTH];
+static size_t redo_len = 0;
+
+static command_changed_fn listener = NULL;
+static void *listener_user = NULL;
+
+static void *xrealloc(void *p, size_t n) {
+    void *tmp = realloc(p, n);
+    if (!tmp) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    return tmp;
+}
+
+static int is_remote(void) {
+    return storage_get_backend() == STORAGE_BACKEND_REMOTE;
+}
+
+static void notify(void) {
+    if (listener) listener(listener_user);
+}
+
+static void push(const StudentDelta *d) {
+    if (queued == queue_cap) {
+        queue_cap = queue_cap ? queue_cap * 2 : 64;
+        queue = xrealloc(queue, queue_cap * sizeof(StudentDelta));
+    }
+    queue[queued++] = *d;
+    if (!d->tombstone && d->rec.id >= queue_next_id) queue_next_id = d->rec.id + 1;
+}
+
+static void push_edit(const GradeEdit *e) {
+    if (edits_queued == edit_cap) {
+        edit_cap = edit_cap ? edit_cap * 2 : 16;
+        edit_queue = xrealloc(edit_queue, edit_cap * sizeof(GradeEdit));
+    }
+    edit_queue[edits_queued++] = *e;
+}
+
+/* Ids are handed out in queue order, as separate calls would have done */
+static int take_id(void) {
+    int next = get_storage_next_id();
+    if (queue_next_id < next) queue_next_id = next;
+    return queue_next_id++;
+}
+
+int command_add(const char *name, double grade) {
+    if (!name) return 0;
+    if (is_remote()) {
+        int id = add_student(name, grade);
+        notify();
+        return id;
+    }
+    StudentDelta d;
+    memset(&d, 0, sizeof(d));
+    strncpy(d.rec.name, name, NAME_LENGTH - 1);
+    d.rec.grade = grade;
+    d.rec.id = take_id();
+    push(&d);
+    return d.rec.id;
+}
+
+void command_remove(int id) {
+    if (is_remote()) {
+        remove_student(id);
+        notify();
+        return;
+    }
+    StudentDelta d;
+    memset(&d, 0, sizeof(d));
+    d.rec.id = id;
+    d.tombstone = 1;
+    push(&d);
+}
+
+int command_merge(const StudentDelta *rows, size_t n) {
+    if (is_remote()) {
+        fprintf(stderr, "Merge import is not available in client mode\n");
+        return -1;
+    }
+    if (!rows) return 0;
+    for (size_t i = 0; i < n; ++i) {
+        StudentDelta d = rows[i];
+        if (!d.tombstone && d.rec.id <= 0) d.rec.id = take_id();
+        push(&d);
+    }
+    return 0;
+}
+
+/* Whether the last queued row for id adds or updates it */
+static int queued_present(int id) {
+    for (size_t i = queued; i-- > 0;)
+        if (queue[i].rec.id == id) return !queue[i].tombstone;
+    return 0;
+}
+
+/* Assessments live in the local gradebook; the protocol carries none */
+static int refuse_remote_assessments(void) {
+    if (!is_remote()) return 0;
+    fprintf(stderr, "Assessments are not available in client mode\n");
+    return -1;
+}
+
+int command_set_score(int id, size_t k, double score) {
+    if (refuse_remote_assessments() != 0) return -1;
+    if (k >= gradebook_count() || id <= 0) return -1;
+    if (!queued_present(id) && !find_student(id)) return -1;
+    GradeEdit e = { id, k, score };
+    push_edit(&e);
+    return 0;
+}
+
+int command_set_weight(size_t k, double weight) {
+    if (refuse_remote_assessments() != 0) return -1;
+    if (k >= gradebook_count() || weight < 0.0) return -1;
+    GradeEdit e = { 0, k, weight };
+    push_edit(&e);
+    return 0;
+}
+
+void command_discard(void) {
+    queued = 0;
+    queue_next_id = 0;
+    edits_queued = 0;
+}
+
+static void batch_free(Batch *b) {
+    free(b->rows);
+    free(b->pos);
+    free(b->scores);
+    free(b->edits);
+    memset(b, 0, sizeof(*b));
+}
+
+static void history_push(Batch *log, size_t *len, const Batch *b) {
+    if (*len == HISTORY_DEPTH) {
+        batch_free(&log[0]);
+        memmove(&log[0], &log[1], (HISTORY_DEPTH - 1) * sizeof(Batch));
+        (*len)--;
+    }
+    log[(*len)++] = *b;
+}
+
+static void history_clear(Batch *log, size_t *len) {
+    while (*len) batch_free(&log[--(*len)]);
+}
+
+/* id -> row of the inverse batch, open addressing with linear probing */
+typedef struct {
+    size_t *slots;
+    size_t mask;
+    Batch *inv;
+    unsigned char *removed; /* the batch ends with this id deleted */
+    size_t at;              /* position of the record being visited */
+} IdIndex;
+
+static size_t hash_id(int id) {
+    return (size_t)((unsigned int)id * 2654435761u);
+}
+
+static size_t id_slot(const IdIndex *ix, int id) {
+    size_t h = hash_id(id) & ix->mask;
+    while (ix->slots[h] != NO_ROW && ix->inv->rows[ix->slots[h]].rec.id != id) h = (h + 1) & ix->mask;
+    return h;
+}
+
+static void note_current(IdIndex *ix, size_t j, const Student *s) {
+    ix->inv->rows[j].rec = *s;
+    ix->inv->rows[j].tombstone = 0;
+}
+
+/* Array backend: one pass over the roster, noting where deleted rows sat */
+static int capture_row(const Student *s, void *user) {
+    IdIndex *ix = user;
+    size_t j = ix->slots[id_slot(ix, s->id)];
+    if (j != NO_ROW) {
+        note_current(ix, j, s);
+        if (ix->removed[j]) {
+            Batch *inv = ix->inv;
+            if (!inv->pos) {
+                inv->pos = xrealloc(NULL, inv->n * sizeof(size_t));
+                for (size_t i = 0; i < inv->n; ++i) inv->pos[i] = NO_ROW;
+            }
+            inv->pos[j] = ix->at;
+        }
+    }
+    ix->at++;
+    return 0;
+}
+
+/* Record into inv how to take storage back to its current state once
+   rows have been applied: one row per id, its current record or a
+   tombstone if it does not exist yet. */
+static void capture_inverse(const StudentDelta *rows, size_t n, Batch *inv) {
+    memset(inv, 0, sizeof(*inv));
+    if (n == 0) return;
+    inv->rows = xrealloc(NULL, n * sizeof(StudentDelta));
+    IdIndex ix;
+    size_t cap = 16;
+    while (cap < n * 2) cap *= 2;
+    ix.slots = xrealloc(NULL, cap * sizeof(size_t));
+    for (size_t i = 0; i < cap; ++i) ix.slots[i] = NO_ROW;
+    ix.mask = cap - 1;
+    ix.inv = inv;
+    ix.removed = xrealloc(NULL, n);
+    ix.at = 0;
+
+    for (size_t i = 0; i < n; ++i) {
+        int id = rows[i].rec.id;
+        if (id <= 0) continue;
+        size_t h = id_slot(&ix, id);
+        if (ix.slots[h] == NO_ROW) {
+            ix.slots[h] = inv->n;
+            memset(&inv->rows[inv->n], 0, sizeof(StudentDelta));
+            inv->rows[inv->n].rec.id = id;
+            inv->rows[inv->n].tombstone = 1;
+            inv->n++;
+        }
+        ix.removed[ix.slots[h]] = (unsigned char)rows[i].tombstone;
+    }
+
+    /* current records: one lookup per id on the B+tree (which orders by
+       id, so no positions), one pass over the array otherwise
+       (find_student is a scan there) */
+    if (storage_get_backend() == STORAGE_BACKEND_BPTREE) {
+        for (size_t j = 0; j < inv->n; ++j) {
+            const Student *s = find_student(inv->rows[j].rec.id);
+            if (s) note_current(&ix, j, s);
+        }
+    } else if (inv->n) {
+        storage_foreach(capture_row, &ix);
+    }
+
+    /* scores of students the batch deletes, so undo brings them back */
+    size_t ncols = gradebook_count();
+    for (size_t j = 0; ncols && j < inv->n; ++j) {
+        if (inv->rows[j].tombstone || !ix.removed[j]) continue;
+        for (size_t k = 0; k < ncols; ++k) {
+            double v = gradebook_score(inv->rows[j].rec.id, k);
+            if (isnan(v)) continue;
+            if (!inv->scores) {
+                inv->ncols = ncols;
+                inv->scores = xrealloc(NULL, inv->n * ncols * sizeof(double));
+                for (size_t i = 0; i < inv->n * ncols; ++i) inv->scores[i] = NAN;
+            }
+            inv->scores[j * ncols + k] = v;
+        }
+    }
+    free(ix.slots);
+    free(ix.removed);
+}
+
+/* Apply the edits of b, recording the old values in reverse order so
+   that the inverse restores the oldest one */
+static void apply_edits(const Batch *b, Batch *inverse) {
+    if (b->nedits == 0) return;
+    inverse->edits = xrealloc(NULL, b->nedits * sizeof(GradeEdit));
+    for (size_t i = 0; i < b->nedits; ++i) {
+        const GradeEdit *e = &b->edits[i];
+        GradeEdit old = *e;
+        int rc;
+        if (e->id == 0) {
+            old.value = gradebook_weight(e->k);
+            rc = gradebook_load_weight(e->k, e->value);
+        } else {
+            old.value = gradebook_score(e->id, e->k);
+            rc = gradebook_load_score(e->id, e->k, e->value);
+        }
+        if (rc == 0) inverse->edits[inverse->nedits++] = old;
+    }
+    for (size_t i = 0, j = inverse->nedits; i + 1 < j; ++i, --j) {
+        GradeEdit t = inverse->edits[i];
+        inverse->edits[i] = inverse->edits[j - 1];
+        inverse->edits[j - 1] = t;
+    }
+}
+
+/* Apply b in one merge and record its inverse. Edits go first, so a
+   student the rows remove takes its new scores with it. */
+static void apply_batch(const Batch *b, Batch *inverse, MergeStats *st) {
+    capture_inverse(b->rows, b->n, inverse);
+    apply_edits(b, inverse);
+    if (b->n) storage_merge_at(b->rows, b->pos, b->n, st);
+    size_t ncols = b->ncols < gradebook_count() ? b->ncols : gradebook_count();
+    for (size_t j = 0; b->scores && j < b->n; ++j) {
+        for (size_t k = 0; k < ncols; ++k) {
+            double v = b->scores[j * b->ncols + k];
+            if (!isnan(v)) gradebook_load_score(b->rows[j].rec.id, k, v);
+        }
+    }
+    /* one pass writes every final the scores or weights moved */
+    if (b->scores || inverse->nedits) gradebook_recompute();
+}
+
+size_t command_commit(MergeStats *stats) {
+    MergeStats st = {0, 0, 0};
+    size_t n = queued + edits_queued;
+    if (n) {
+        Batch b = { queue, queued, NULL, 0, NULL, edit_queue, edits_queued };
+        Batch inv;
+        apply_batch(&b, &inv, &st);
+        history_push(undo_log, &undo_len, &inv);
+        history_clear(redo_log, &redo_len);
+    }
+    command_discard();
+    if (stats) *stats = st;
+    if (n) notify();
+    return n;
+}
+
+/* Pop a batch from one log, apply it and push its inverse onto the other */
+static int replay(Batch *from, size_t *from_len, Batch *to, size_t *to_len) {
+    if (*from_len == 0 || is_remote()) return -1;
+    Batch b = from[--(*from_len)];
+    Batch inv;
+    apply_batch(&b, &inv, NULL);
+    batch_free(&b);
+    history_push(to, to_len, &inv);
+    notify();
+    return 0;
+}
+
+int command_undo(void) {
+    return replay(undo_log, &undo_len, redo_log, &redo_len);
+}
+
+int command_redo(void) {
+    return replay(redo_log, &redo_len, undo_log, &undo_len);
+}
+
+int command_can_undo(void) { return undo_len > 0 && !is_remote(); }
+
+int command_can_redo(void) { return redo_len > 0 && !is_remote(); }
+
+void command_set_listener(command_changed_fn fn, void *user) {
+    listener = fn;
+    listener_user = user;
+}
+
+void command_reset(void) {
+    command_discard();
+    free(queue);
+    queue = NULL;
+    queue_cap = 0;
+    free(edit_queue);
+    edit_queue = NULL;
+    edit_cap = 0;
+    history_clear(undo_log, &undo_len);
+    history_clear(redo_log, &redo_len);
+}
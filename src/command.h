@@ -0,0 +1,53 @@
+#ifndef COMMAND_H
+#define COMMAND_H
+
+/* Command layer between the UIs and storage.h. Edits are queued and
+   command_commit applies the whole queue as one storage_merge: a single
+   pass over the array (or one lookup per row on the B+tree) however many
+   rows it touches, followed by one change notification. Each committed
+   batch is recorded by its inverse, so undo and redo are batches too.
+
+   Ids are assigned when a command is queued, so later commands can refer
+   to students added earlier in the same batch. Score and weight edits
+   join the batch too, and the finals they move are written in the same
+   commit. In client mode adds and removes are forwarded one by one and
+   nothing is recorded for undo; merges and assessment edits are refused,
+   as the protocol does not carry them. */
+
+#include "storage.h"
+
+/* Called once after every commit, undo or redo that changed storage */
+typedef void (*command_changed_fn)(void *user);
+
+/* Queue a new student; returns the id it will get (0 in client mode) */
+int command_add(const char *name, double grade);
+void command_remove(int id);
+/* Queue delta rows as storage_merge would apply them; 0, or -1 in client
+   mode, which has no merge */
+int command_merge(const StudentDelta *rows, size_t n);
+/* Queue a score for assessment k (NAN clears it); -1 if k is out of
+   range, no student (stored or queued) has that id, or in client mode */
+int command_set_score(int id, size_t k, double score);
+/* Queue a weight for assessment k; -1 if k or the weight is invalid, or
+   in client mode */
+int command_set_weight(size_t k, double weight);
+/* Drop the queue without applying it */
+void command_discard(void);
+
+/* Apply the queue as one batch; stats may be NULL. Returns the number of
+   commands applied. */
+size_t command_commit(MergeStats *stats);
+
+/* Revert or reapply the last batch; return 0, or -1 if there is none */
+int command_undo(void);
+int command_redo(void);
+int command_can_undo(void);
+int command_can_redo(void);
+
+void command_set_listener(command_changed_fn fn, void *user);
+/* Forget the queue and all history. Call it on exit and whenever storage
+   changes outside this layer (a load, or a live reload of the data file):
+   the recorded inverses would otherwise undo that change too. */
+void command_reset(void);
+
+#endif /* COMMAND_H */
@@ -3,57 +3,156 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <math.h>
+#include <stdint.h>
+#include <sys/stat.h>
 #include "csv.h"
+#include "csvscan.h"
+#include "gradebook.h"
 #include "storage.h"
+#include "threadpool.h"
+#include "watch.h"
 
 
 #define LINE_LEN 1024
+/* Longest formatted row: id, a fully quoted name and any %.2f double */
+#define ROW_MAX (2 * NAME_LENGTH + 400)
+/* ... followed by a ',' and any %.2f double per assessment */
+#define SCORES_ROW_MAX (ROW_MAX + MAX_ASSESSMENTS * 400)
+#define PATH_LEN 1024
+#define MAX_SHARDS 256
 
-/* Helper: trim newline/end CR */
-static void trim_newline(char *s) {
-    size_t n = strlen(s);
-    if (n && (s[n-1] == '\n' || s[n-1] == '\r')) s[n-1] = '\0';
+/* Format one record into buf (ROW_MAX bytes) and return its length.
+   Names containing commas or quotes are quoted and quotes doubled per
+   CSV rules. */
+static size_t format_row(const Student *s, char *buf) {
+    const char *name = s->name;
+    int needs_quotes = strchr(name, ',') || strchr(name, '"') || strchr(name, '\n');
+    if (!needs_quotes) {
+        int n = snprintf(buf, ROW_MAX, "%d,%s,%.2f\n", s->id, name, s->grade);
+        return n < ROW_MAX ? (size_t)n : ROW_MAX - 1;
+    }
+
+    size_t n = (size_t)snprintf(buf, ROW_MAX, "%d,\"", s->id);
+    for (const char *p = name; *p; ++p) {
+        if (*p == '"') buf[n++] = '"';
+        buf[n++] = *p;
+    }
+    buf[n++] = '"';
+    n += (size_t)snprintf(buf + n, ROW_MAX - n, ",%.2f\n", s->grade);
+    return n < ROW_MAX ? n : ROW_MAX - 1;
 }
 
-/* Save students to CSV.
-   Names containing commas or quotes are quoted and quotes doubled per CSV rules.
-*/
+static int write_row(const Student *s, void *user) {
+    char buf[ROW_MAX];
+    fwrite(buf, 1, format_row(s, buf), (FILE *)user);
+    return 0;
+}
+
+/* With assessments the file starts with a header naming them and their
+   weights ("id,name,grade,Midterm:0.4,Exam:0.6"), and every row carries
+   one score column per assessment after the final grade; a missing score
+   is an empty field. Readers that only know id,name,grade still work.
+   Weights are written in the shortest form that reads back as the same
+   double (%.17g at most, as in the shard manifest), so a save and load
+   never moves a final. */
+static void write_header(FILE *f) {
+    fputs("id,name,grade", f);
+    for (size_t k = 0; k < gradebook_count(); ++k) {
+        double w = gradebook_weight(k);
+        char buf[32];
+        for (int prec = 6; prec <= 17; ++prec) {
+            snprintf(buf, sizeof(buf), "%.*g", prec, w);
+            if (strtod(buf, NULL) == w) break;
+        }
+        fprintf(f, ",%s:%s", gradebook_name(k), buf);
+    }
+    fputc('\n', f);
+}
+
+/* format_row plus the score columns; buf holds SCORES_ROW_MAX bytes.
+   Only reads the gradebook, so shard writers may call it concurrently. */
+static size_t format_row_scores(const Student *s, char *buf) {
+    size_t n = format_row(s, buf) - 1; /* without the newline */
+    for (size_t k = 0; k < gradebook_count(); ++k) {
+        double v = gradebook_score(s->id, k);
+        if (isnan(v)) buf[n++] = ',';
+        else n += (size_t)snprintf(buf + n, SCORES_ROW_MAX - n, ",%.2f", v);
+    }
+    buf[n++] = '\n';
+    return n;
+}
+
+static int write_row_scores(const Student *s, void *user) {
+    char buf[SCORES_ROW_MAX];
+    fwrite(buf, 1, format_row_scores(s, buf), (FILE *)user);
+    return 0;
+}
+
+/* Set when the data on disk could not be loaded (bad manifest or shards).
+   Saving then would replace the only good copy with whatever is in
+   memory, so save_to_file refuses until a load succeeds. */
+static int load_failed = 0;
+
+static int refuse_save(const char *filename) {
+    if (!load_failed) return 0;
+    fprintf(stderr, "Error: %s could not be loaded; not saving over it. "
+                    "Repair or move the files aside and restart.\n", filename);
+    return 1;
+}
+
+/* GRADE_SHARDS=N (N > 1) switches save/load to the sharded format */
+static size_t configured_shards(void) {
+    const char *env = getenv("GRADE_SHARDS");
+    long n = env ? strtol(env, NULL, 10) : 0;
+    if (n <= 1) return 0;
+    return n > MAX_SHARDS ? MAX_SHARDS : (size_t)n;
+}
+
+/* Save students to CSV in the current storage order. */
 void save_to_file(const char *filename) {
     if (!filename) return;
+    if (storage_get_backend() == STORAGE_BACKEND_REMOTE) {
+        /* the server owns the data file */
+        storage_request_save();
+        return;
+    }
+    if (refuse_save(filename)) return;
+    size_t shards = configured_shards();
+    if (shards) {
+        save_sharded(filename, shards);
+        return;
+    }
     FILE *f = fopen(filename, "w");
     if (!f) {
         perror("fopen");
         return;
     }
 
-    Student *arr = get_storage_array();
-    size_t cnt = get_storage_count();
-
-    for (size_t i = 0; i < cnt; ++i) {
-        const char *name = arr[i].name;
-        int needs_quotes = strchr(name, ',') || strchr(name, '"') || strchr(name, '\n');
-        if (needs_quotes) {
-            fputc('"', f);
-            for (const char *p = name; *p; ++p) {
-                if (*p == '"') { fputc('"', f); fputc('"', f); }
-                else fputc(*p, f);
-            }
-            fputc('"', f);
-            fprintf(f, ",%.2f\n", arr[i].grade);
-        } else {
-            fprintf(f, "%d,%s,%.2f\n", arr[i].id, name, arr[i].grade);
-        }
+    size_t cnt;
+    if (gradebook_count()) {
+        write_header(f);
+        cnt = storage_foreach(write_row_scores, f);
+    } else {
+        cnt = storage_foreach(write_row, f);
     }
 
     fclose(f);
+    watch_sync(filename);
     printf("Saved %zu students to %s\n", cnt, filename);
 }
 
 /* Parse a single CSV line into id, name, grade.
    Returns 1 on success, 0 on failure.
    Handles quoted name fields with doubled quotes.
+   Only blanks may follow the grade. If out_rest is not NULL, further
+   columns are allowed too and out_rest receives the ',' before them (or
+   the end of the line).
+   This is the general path: it accepts anything the fast parser below
+   does and also stray spaces, signs, exponents and other strtod forms.
 */
-static int parse_csv_line(const char *line, int *out_id, char out_name[NAME_LENGTH], double *out_grade) {
+static int parse_csv_scalar(const char *line, int *out_id, char out_name[NAME_LENGTH], double *out_grade,
+                            const char **out_rest) {
     const char *p = line;
     /* parse id */
     while (*p && isspace((unsigned char)*p)) p++;
@@ -110,46 +209,247 @@ static int parse_csv_line(const char *line, int *out_id, char out_name[NAME_LENG
     char *endptr;
     double grade = strtod(p, &endptr);
     if (p == endptr) return 0;
+    p = endptr;
+    while (*p && isspace((unsigned char)*p)) p++;
+    if (*p != '\0' && !(out_rest && *p == ',')) return 0;
 
     /* copy out */
     *out_id = id;
     strncpy(out_name, namebuf, NAME_LENGTH - 1);
     out_name[NAME_LENGTH - 1] = '\0';
     *out_grade = grade;
+    if (out_rest) *out_rest = p;
     return 1;
 }
 
+/* Same rules as parse_csv_scalar, limited to the rows our writer emits:
+   plain digits for the id, a name that is either unquoted or quoted up
+   to a closing quote directly followed by ',', and a [-]digits.digits
+   grade ending the record (or followed by ',' when out_rest is wanted).
+   Returns 0 for anything else, which then goes to the scalar parser. */
+static int parse_csv_fast(const char *line, size_t len, int *out_id, char out_name[NAME_LENGTH],
+                          double *out_grade, const char **out_rest) {
+    const char *p = line, *end = line + len;
+    int id;
+    p = scan_int(p, end, &id);
+    if (!p || p == end || *p != ',') return 0;
+    p++;
+
+    /* same cap as the scalar parser */
+    const size_t max_name = NAME_LENGTH - 2;
+    size_t ni = 0;
+    if (p < end && *p == '"') {
+        p++;
+        for (;;) {
+            const char *q = scan_find1(p, end, '"');
+            if (q == end) return 0; /* unterminated */
+            size_t n = (size_t)(q - p);
+            if (n > max_name - ni) n = max_name - ni;
+            memcpy(out_name + ni, p, n);
+            ni += n;
+            if (q + 1 < end && q[1] == '"') {
+                if (ni < max_name) out_name[ni++] = '"';
+                p = q + 2;
+            } else {
+                p = q + 1;
+                break;
+            }
+        }
+        if (p == end || *p != ',') return 0;
+    } else {
+        const char *q = scan_find1(p, end, ',');
+        if (q == end) return 0;
+        size_t n = (size_t)(q - p);
+        ni = n < max_name ? n : max_name;
+        memcpy(out_name, p, ni);
+        p = q;
+    }
+    p++; /* skip comma */
+
+    double grade;
+    p = scan_decimal(p, end, &grade);
+    if (!p || (p < end && (*p != ',' || !out_rest))) return 0;
+
+    out_name[ni] = '\0';
+    *out_id = id;
+    *out_grade = grade;
+    if (out_rest) *out_rest = p;
+    return 1;
+}
+
+/* line[len] must be '\0'. Define CSV_VERIFY to check every fast parse
+   against the scalar parser. */
+static int parse_csv_line(const char *line, size_t len, int *out_id, char out_name[NAME_LENGTH],
+                          double *out_grade, const char **out_rest) {
+    if (parse_csv_fast(line, len, out_id, out_name, out_grade, out_rest)) {
+#ifdef CSV_VERIFY
+        int id;
+        char name[NAME_LENGTH];
+        double grade;
+        const char *rest;
+        if (!parse_csv_scalar(line, &id, name, &grade, &rest) || id != *out_id ||
+            strcmp(name, out_name) != 0 || grade != *out_grade || (out_rest && rest != *out_rest)) {
+            fprintf(stderr, "CSV_VERIFY: fast parser disagrees on: %s\n", line);
+            abort();
+        }
+#endif
+        return 1;
+    }
+    return parse_csv_scalar(line, out_id, out_name, out_grade, out_rest);
+}
+
+int parse_student_line(const char *line, Student *out) {
+    return parse_csv_line(line, strlen(line), &out->id, out->name, &out->grade, NULL);
+}
+
+/* Read the rest of f into a NUL-terminated buffer; NULL if out of memory */
+static char *read_all(FILE *f, size_t *out_len) {
+    size_t cap = 1 << 16, len = 0;
+    char *buf = malloc(cap);
+    if (!buf) return NULL;
+    size_t got;
+    while ((got = fread(buf + len, 1, cap - len - 1, f)) > 0) {
+        len += got;
+        if (len == cap - 1) {
+            char *tmp = realloc(buf, cap * 2);
+            if (!tmp) {
+                free(buf);
+                return NULL;
+            }
+            buf = tmp;
+            cap *= 2;
+        }
+    }
+    buf[len] = '\0';
+    *out_len = len;
+    return buf;
+}
+
+static void load_csv(const char *filename);
+
 /* Load all students from file. This replaces the in-memory array. */
 void load_from_file(const char *filename) {
     if (!filename) return;
-    FILE *f = fopen(filename, "r");
+    if (storage_get_backend() == STORAGE_BACKEND_REMOTE) return;
+    load_failed = 0;
+    if (configured_shards()) load_sharded(filename);
+    else load_csv(filename);
+}
+
+size_t parse_csv_header(const char *line, char names[][ASSESSMENT_NAME_LEN], double *weights, size_t max) {
+    const char *p = line;
+    size_t cols = 0;
+    for (int field = 0; *p; ++field) {
+        const char *end = strchr(p, ',');
+        size_t len = end ? (size_t)(end - p) : strlen(p);
+        if (field >= 3) {
+            if (cols < max) {
+                const char *colon = memchr(p, ':', len);
+                size_t nlen = colon ? (size_t)(colon - p) : len;
+                weights[cols] = colon ? strtod(colon + 1, NULL) : 1.0;
+                names[cols][0] = '\0';
+                if (nlen < ASSESSMENT_NAME_LEN) {
+                    memcpy(names[cols], p, nlen);
+                    names[cols][nlen] = '\0';
+                }
+            }
+            cols++;
+        }
+        if (!end) break;
+        p = end + 1;
+    }
+    return cols;
+}
+
+/* "id,name,grade,<assessment>:<weight>,..." */
+static void parse_header(const char *line) {
+    char names[MAX_ASSESSMENTS][ASSESSMENT_NAME_LEN];
+    double weights[MAX_ASSESSMENTS];
+    size_t cols = parse_csv_header(line, names, weights, MAX_ASSESSMENTS);
+    for (size_t k = 0; k < cols; ++k) {
+        if (k >= MAX_ASSESSMENTS || gradebook_add_assessment(names[k], weights[k]) < 0)
+            fprintf(stderr, "Warning: ignoring assessment column %zu\n", k + 4);
+    }
+}
+
+/* Score columns after the grade, in header order; an empty or absent
+   column is a missing score (NAN). Returns 0 if a column is not a number
+   or data follows the last one (empty trailing columns are fine). */
+static int read_scores(const char *p, double *out, size_t ncols) {
+    for (size_t k = 0; k < ncols; ++k) out[k] = NAN;
+    for (size_t k = 0; k < ncols && *p == ','; ++k) {
+        p++;
+        while (*p == ' ') p++;
+        if (*p == ',' || *p == '\0') continue;
+        char *endptr;
+        double v = strtod(p, &endptr);
+        if (endptr == p) return 0;
+        out[k] = v;
+        p = endptr;
+        while (*p == ' ') p++;
+    }
+    while (*p == ',' || isspace((unsigned char)*p)) p++;
+    return *p == '\0';
+}
+
+int parse_student_scores(const char *line, Student *out, double *scores, size_t ncols) {
+    const char *rest;
+    if (!parse_csv_line(line, strlen(line), &out->id, out->name, &out->grade, &rest)) return 0;
+    return read_scores(rest, scores, ncols);
+}
+
+static void load_csv(const char *filename) {
+    FILE *f = fopen(filename, "rb");
     if (!f) {
         /* no file yet is OK */
         return;
     }
-    char line[LINE_LEN];
+    /* whole file at once: records are split on unquoted newlines, so
+       neither a line length limit nor a newline in a name gets in the way */
+    size_t len = 0;
+    char *buf = read_all(f, &len);
+    fclose(f);
+    if (!buf) {
+        fprintf(stderr, "Memory allocation failed while loading CSV\n");
+        return;
+    }
     Student *arr = NULL;
     size_t cap = 0;
     size_t cnt = 0;
     int max_id = 0;
+    int first = 1;
 
-    while (fgets(line, sizeof(line), f)) {
-        trim_newline(line);
-        if (line[0] == '\0') continue;
+    /* the file defines the assessments, if any */
+    gradebook_clear();
+    char *cursor = buf, *line;
+    size_t n;
+    while ((line = scan_next_record(&cursor, buf + len, &n))) {
+        if (first && strncmp(line, "id,", 3) == 0) {
+            parse_header(line);
+            first = 0;
+            continue;
+        }
+        first = 0;
         int id;
         char name[NAME_LENGTH];
         double grade;
-        if (!parse_csv_line(line, &id, name, &grade)) {
+        const char *rest;
+        double scores[MAX_ASSESSMENTS];
+        if (!parse_csv_line(line, n, &id, name, &grade, &rest) ||
+            !read_scores(rest, scores, gradebook_count())) {
             fprintf(stderr, "Warning: failed to parse line: %s\n", line);
             continue;
         }
+        for (size_t k = 0; k < gradebook_count(); ++k) {
+            if (!isnan(scores[k])) gradebook_load_score(id, k, scores[k]);
+        }
         if (cnt >= cap) {
             size_t newcap = cap == 0 ? 8 : cap * 2;
             Student *tmp = realloc(arr, newcap * sizeof(Student));
             if (!tmp) {
                 fprintf(stderr, "Memory allocation failed while loading CSV\n");
                 free(arr);
-                fclose(f);
+                free(buf);
                 return;
             }
             arr = tmp;
@@ -162,10 +462,472 @@ void load_from_file(const char *filename) {
         cnt++;
         if (id > max_id) max_id = id;
     }
-    fclose(f);
+    free(buf);
+
+    /* the grade of a student with scores is its weighted final */
+    if (gradebook_count()) {
+        for (size_t i = 0; i < cnt; ++i) gradebook_final(arr[i].id, &arr[i].grade);
+    }
 
     /* Replace storage content with the loaded array.
        next_id should be max_id + 1 so we don't reuse ids. */
     replace_storage_content(arr, cnt, max_id + 1);
     printf("Loaded %zu students from %s\n", cnt, filename);
 }
+
+/* Parse a delta line. "-<id>" (optionally followed by more fields) is a
+   tombstone; anything else is a regular record. Returns 1 on success, 0
+   if the line does not parse and -1 if it carries score columns. */
+static int parse_delta_line(const char *line, size_t len, StudentDelta *out) {
+    const char *p = line;
+    while (*p && isspace((unsigned char)*p)) p++;
+    if (*p == '-') {
+        char *endptr;
+        long id = strtol(p + 1, &endptr, 10);
+        if (endptr == p + 1 || id <= 0) return 0;
+        memset(out, 0, sizeof(*out));
+        out->rec.id = (int)id;
+        out->tombstone = 1;
+        return 1;
+    }
+    out->tombstone = 0;
+    const char *rest;
+    if (!parse_csv_line(line, len, &out->rec.id, out->rec.name, &out->rec.grade, &rest)) return 0;
+    /* data in further columns can only be scores */
+    return read_scores(rest, NULL, 0) ? 1 : -1;
+}
+
+int read_delta_file(const char *filename, StudentDelta **out, size_t *out_n) {
+    *out = NULL;
+    *out_n = 0;
+    if (!filename) return -1;
+    FILE *f = fopen(filename, "rb");
+    if (!f) {
+        perror("fopen");
+        return -1;
+    }
+    size_t len = 0;
+    char *buf = read_all(f, &len);
+    fclose(f);
+    if (!buf) {
+        fprintf(stderr, "Memory allocation failed while merging CSV\n");
+        return -1;
+    }
+    StudentDelta *rows = NULL;
+    size_t cap = 0;
+    size_t cnt = 0;
+
+    /* Merge rows carry id, name and grade only: scores and weights are
+       not merged, and dropping them silently would lose data */
+    int scores = 0;
+    char *cursor = buf, *line;
+    size_t n;
+    while ((line = scan_next_record(&cursor, buf + len, &n))) {
+        if (cnt == 0 && strncmp(line, "id,", 3) == 0) {
+            char names[1][ASSESSMENT_NAME_LEN];
+            double weights[1];
+            if (parse_csv_header(line, names, weights, 1) > 0) {
+                scores = 1;
+                break;
+            }
+            continue; /* plain id,name,grade header */
+        }
+        if (cnt >= cap) {
+            size_t newcap = cap == 0 ? 64 : cap * 2;
+            StudentDelta *tmp = realloc(rows, newcap * sizeof(StudentDelta));
+            if (!tmp) {
+                fprintf(stderr, "Memory allocation failed while merging CSV\n");
+                free(rows);
+                free(buf);
+                return -1;
+            }
+            rows = tmp;
+            cap = newcap;
+        }
+        int res = parse_delta_line(line, n, &rows[cnt]);
+        if (res < 0) {
+            scores = 1;
+            break;
+        }
+        if (res == 0) {
+            fprintf(stderr, "Warning: failed to parse line: %s\n", line);
+            continue;
+        }
+        cnt++;
+    }
+    free(buf);
+    if (scores) {
+        fprintf(stderr, "Error: %s has assessment score columns; merge files take "
+                        "id,name,grade rows only\n", filename);
+        free(rows);
+        return -1;
+    }
+    *out = rows;
+    *out_n = cnt;
+    return 0;
+}
+
+/* ---- sharded persistence ----
+   Each save writes a new generation of shard files <file>.<gen>.<k>, each
+   a contiguous slice of the roster in its current order: the snapshot
+   get_storage_array returns, which after a sort is sort order on either
+   backend. Shards are therefore not id ranges, and a load reads every one;
+   reading them back in shard order restores the order on the array
+   backend. <file>.manifest records the generation plus the row count,
+   byte size and FNV-1a checksum of every shard, and the assessments with
+   their weights; shard rows then carry the score columns as in the plain
+   file. The manifest is written last through a rename, so a crash
+   mid-save leaves the previous generation in charge. The previous
+   generation is deleted only if it is the one the roster was loaded
+   from, so a set that failed validation is never clobbered. */
+
+#define MANIFEST_MAGIC "grade_system shard manifest"
+/* version 2 added assessment lines; version 1 manifests still load */
+#define MANIFEST_VERSION 2
+#define FNV_OFFSET 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+typedef struct {
+    char path[PATH_LEN];
+    Student *arr;        /* save: slice to write; load: parsed rows */
+    size_t rows;
+    size_t bytes;
+    uint64_t checksum;
+    /* load only: values promised by the manifest */
+    size_t want_rows;
+    size_t want_bytes;
+    uint64_t want_checksum;
+    size_t ncols;        /* assessments */
+    double *scores;      /* load: rows * ncols, NAN when missing */
+    int max_id;
+    int ok;
+} ShardJob;
+
+typedef struct {
+    unsigned long generation;
+    int next_id;
+    size_t nshards;
+    ShardJob *jobs;
+    size_t nassess;
+    char names[MAX_ASSESSMENTS][ASSESSMENT_NAME_LEN];
+    double weights[MAX_ASSESSMENTS];
+} Manifest;
+
+/* generation the in-memory roster was loaded from or last saved as */
+static unsigned long current_generation = 0;
+static int have_generation = 0;
+
+static uint64_t fnv1a(uint64_t h, const char *p, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        h ^= (unsigned char)p[i];
+        h *= FNV_PRIME;
+    }
+    return h;
+}
+
+static void shard_path(char *out, const char *filename, unsigned long gen, size_t k) {
+    snprintf(out, PATH_LEN, "%s.%lu.%zu", filename, gen, k);
+}
+
+/* Returns 1 if read, 0 if there is no manifest, -1 if it is malformed */
+static int read_manifest(const char *filename, Manifest *m) {
+    char path[PATH_LEN];
+    snprintf(path, sizeof(path), "%s.manifest", filename);
+    memset(m, 0, sizeof(*m));
+    m->next_id = 1;
+    FILE *f = fopen(path, "r");
+    if (!f) return 0;
+
+    char line[LINE_LEN];
+    int version = 0, have_gen = 0;
+    int bad = !fgets(line, sizeof(line), f) || strncmp(line, MANIFEST_MAGIC, strlen(MANIFEST_MAGIC)) != 0;
+    while (!bad && fgets(line, sizeof(line), f)) {
+        size_t k, rows, bytes;
+        unsigned long long sum;
+        double weight;
+        int name_at = 0;
+        if (sscanf(line, "version %d", &version) == 1) continue;
+        if (sscanf(line, "assessment %lf %n", &weight, &name_at) == 1 && name_at > 0) {
+            char *name = line + name_at;
+            name[strcspn(name, "\n")] = '\0';
+            if (m->nassess == MAX_ASSESSMENTS || !name[0] || strlen(name) >= ASSESSMENT_NAME_LEN) { bad = 1; break; }
+            strcpy(m->names[m->nassess], name);
+            m->weights[m->nassess++] = weight;
+            continue;
+        }
+        if (sscanf(line, "generation %lu", &m->generation) == 1) { have_gen = 1; continue; }
+        if (sscanf(line, "next_id %d", &m->next_id) == 1) continue;
+        if (sscanf(line, "shards %zu", &m->nshards) == 1) {
+            if (m->jobs || !have_gen || m->nshards == 0 || m->nshards > MAX_SHARDS) { bad = 1; break; }
+            m->jobs = calloc(m->nshards, sizeof(ShardJob));
+            if (!m->jobs) { bad = 1; break; }
+            continue;
+        }
+        if (sscanf(line, "shard %zu rows %zu bytes %zu fnv1a %llx", &k, &rows, &bytes, &sum) == 4) {
+            if (!m->jobs || k >= m->nshards || m->jobs[k].path[0]) { bad = 1; break; }
+            shard_path(m->jobs[k].path, filename, m->generation, k);
+            m->jobs[k].want_rows = rows;
+            m->jobs[k].want_bytes = bytes;
+            m->jobs[k].want_checksum = (uint64_t)sum;
+            continue;
+        }
+        bad = 1;
+    }
+    fclose(f);
+    if (version < 1 || version > MANIFEST_VERSION || !m->jobs) bad = 1;
+    for (size_t k = 0; !bad && k < m->nshards; ++k) {
+        if (!m->jobs[k].path[0]) bad = 1;
+    }
+    if (bad) {
+        fprintf(stderr, "Error: %s is not a valid shard manifest\n", path);
+        free(m->jobs);
+        m->jobs = NULL;
+        return -1;
+    }
+    return 1;
+}
+
+static void save_shard_task(void *arg) {
+    ShardJob *j = arg;
+    FILE *f = fopen(j->path, "w");
+    if (!f) {
+        perror(j->path);
+        j->ok = 0;
+        return;
+    }
+    setvbuf(f, NULL, _IOFBF, 1 << 16);
+    char buf[SCORES_ROW_MAX];
+    uint64_t h = FNV_OFFSET;
+    size_t bytes = 0;
+    for (size_t i = 0; i < j->rows; ++i) {
+        size_t len = j->ncols ? format_row_scores(&j->arr[i], buf) : format_row(&j->arr[i], buf);
+        h = fnv1a(h, buf, len);
+        fwrite(buf, 1, len, f);
+        bytes += len;
+    }
+    j->ok = !ferror(f);
+    if (fclose(f) != 0) j->ok = 0;
+    j->bytes = bytes;
+    j->checksum = h;
+}
+
+static void remove_shards(ShardJob *jobs, size_t nshards) {
+    for (size_t k = 0; k < nshards; ++k) remove(jobs[k].path);
+}
+
+void save_sharded(const char *filename, size_t nshards) {
+    if (!filename || refuse_save(filename)) return;
+    if (nshards < 1) nshards = 1;
+    if (nshards > MAX_SHARDS) nshards = MAX_SHARDS;
+
+    Manifest prev;
+    int have_prev = read_manifest(filename, &prev) == 1;
+    unsigned long gen = have_prev ? prev.generation + 1 : 1;
+    if (have_generation && current_generation >= gen) gen = current_generation + 1;
+
+    Student *arr = get_storage_array();
+    size_t cnt = get_storage_count();
+    ShardJob *jobs = calloc(nshards, sizeof(ShardJob));
+    if (!jobs) {
+        fprintf(stderr, "Memory allocation failed while saving shards\n");
+        free(prev.jobs);
+        return;
+    }
+
+    TaskGroup g;
+    pool_group_init(&g);
+    size_t start = 0;
+    for (size_t k = 0; k < nshards; ++k) {
+        size_t n = cnt / nshards + (k < cnt % nshards ? 1 : 0);
+        shard_path(jobs[k].path, filename, gen, k);
+        jobs[k].arr = arr + start;
+        jobs[k].rows = n;
+        jobs[k].ncols = gradebook_count();
+        start += n;
+        pool_spawn(&g, save_shard_task, &jobs[k]);
+    }
+    pool_wait(&g);
+
+    int ok = 1;
+    for (size_t k = 0; k < nshards; ++k) {
+        if (!jobs[k].ok) {
+            fprintf(stderr, "Error: failed to write shard %s; manifest not updated\n", jobs[k].path);
+            ok = 0;
+        }
+    }
+
+    char path[PATH_LEN], tmp[PATH_LEN];
+    snprintf(path, sizeof(path), "%s.manifest", filename);
+    snprintf(tmp, sizeof(tmp), "%s.manifest.tmp", filename);
+    FILE *f = ok ? fopen(tmp, "w") : NULL;
+    if (f) {
+        fprintf(f, "%s\n", MANIFEST_MAGIC);
+        fprintf(f, "version %d\n", MANIFEST_VERSION);
+        fprintf(f, "generation %lu\n", gen);
+        fprintf(f, "next_id %d\n", get_storage_next_id());
+        for (size_t k = 0; k < gradebook_count(); ++k)
+            fprintf(f, "assessment %.17g %s\n", gradebook_weight(k), gradebook_name(k));
+        fprintf(f, "shards %zu\n", nshards);
+        for (size_t k = 0; k < nshards; ++k) {
+            fprintf(f, "shard %zu rows %zu bytes %zu fnv1a %016llx\n",
+                    k, jobs[k].rows, jobs[k].bytes, (unsigned long long)jobs[k].checksum);
+        }
+        ok = !ferror(f);
+        if (fclose(f) != 0) ok = 0;
+        if (!ok || rename(tmp, path) != 0) {
+            perror("manifest");
+            ok = 0;
+        }
+    } else if (ok) {
+        perror("fopen");
+        ok = 0;
+    }
+
+    if (!ok) {
+        remove_shards(jobs, nshards);
+        free(jobs);
+        free(prev.jobs);
+        return;
+    }
+    if (have_prev && have_generation && prev.generation == current_generation)
+        remove_shards(prev.jobs, prev.nshards);
+    current_generation = gen;
+    have_generation = 1;
+    free(jobs);
+    free(prev.jobs);
+    printf("Saved %zu students to %s (%zu shards)\n", cnt, filename, nshards);
+}
+
+/* Read, verify and parse one shard into its own array */
+static void load_shard_task(void *arg) {
+    ShardJob *j = arg;
+    j->ok = 0;
+    FILE *f = fopen(j->path, "rb");
+    if (!f) {
+        perror(j->path);
+        return;
+    }
+    struct stat st;
+    if (fstat(fileno(f), &st) != 0 || (size_t)st.st_size != j->want_bytes) {
+        fprintf(stderr, "Error: %s: size does not match manifest\n", j->path);
+        fclose(f);
+        return;
+    }
+    char *buf = malloc(j->want_bytes + 1);
+    if (!buf) {
+        fprintf(stderr, "Memory allocation failed while loading %s\n", j->path);
+        fclose(f);
+        return;
+    }
+    size_t got = fread(buf, 1, j->want_bytes, f);
+    fclose(f);
+    buf[got] = '\0';
+    if (got != j->want_bytes || fnv1a(FNV_OFFSET, buf, got) != j->want_checksum) {
+        fprintf(stderr, "Error: %s: checksum does not match manifest\n", j->path);
+        free(buf);
+        return;
+    }
+
+    j->arr = malloc((j->want_rows ? j->want_rows : 1) * sizeof(Student));
+    if (j->ncols) j->scores = malloc((j->want_rows ? j->want_rows : 1) * j->ncols * sizeof(double));
+    if (!j->arr || (j->ncols && !j->scores)) {
+        fprintf(stderr, "Memory allocation failed while loading %s\n", j->path);
+        free(buf);
+        return;
+    }
+    size_t n = 0;
+    int max_id = 0;
+    char *cursor = buf, *line;
+    size_t len;
+    while ((line = scan_next_record(&cursor, buf + got, &len))) {
+        Student s;
+        const char *rest;
+        if (n < j->want_rows && parse_csv_line(line, len, &s.id, s.name, &s.grade, &rest) &&
+            read_scores(rest, j->scores ? j->scores + n * j->ncols : NULL, j->ncols)) {
+            j->arr[n++] = s;
+            if (s.id > max_id) max_id = s.id;
+        } else {
+            fprintf(stderr, "Warning: %s: unexpected line: %s\n", j->path, line);
+        }
+    }
+    free(buf);
+    j->rows = n;
+    j->max_id = max_id;
+    j->ok = (n == j->want_rows);
+    if (!j->ok) fprintf(stderr, "Error: %s: row count does not match manifest\n", j->path);
+}
+
+void load_sharded(const char *filename) {
+    if (!filename) return;
+    load_failed = 0;
+    Manifest m;
+    int res = read_manifest(filename, &m);
+    if (res == 0) {
+        /* no shards yet: start from the plain CSV if there is one */
+        load_csv(filename);
+        return;
+    }
+    if (res < 0) {
+        load_failed = 1;
+        return;
+    }
+
+    TaskGroup g;
+    pool_group_init(&g);
+    for (size_t k = 0; k < m.nshards; ++k) {
+        m.jobs[k].ncols = m.nassess;
+        pool_spawn(&g, load_shard_task, &m.jobs[k]);
+    }
+    pool_wait(&g);
+
+    size_t total = 0;
+    int ok = 1, max_id = 0;
+    for (size_t k = 0; k < m.nshards; ++k) {
+        ok = ok && m.jobs[k].ok;
+        total += m.jobs[k].rows;
+        if (m.jobs[k].max_id > max_id) max_id = m.jobs[k].max_id;
+    }
+    Student *arr = ok ? malloc((total ? total : 1) * sizeof(Student)) : NULL;
+    if (ok && !arr) fprintf(stderr, "Memory allocation failed while loading shards\n");
+    if (arr) {
+        /* the manifest defines the assessments, if any */
+        gradebook_clear();
+        for (size_t a = 0; a < m.nassess; ++a) {
+            if (gradebook_add_assessment(m.names[a], m.weights[a]) < 0)
+                fprintf(stderr, "Warning: ignoring assessment %s\n", m.names[a]);
+        }
+        size_t ncols = gradebook_count() < m.nassess ? gradebook_count() : m.nassess;
+        size_t pos = 0;
+        for (size_t k = 0; k < m.nshards; ++k) {
+            const ShardJob *j = &m.jobs[k];
+            memcpy(arr + pos, j->arr, j->rows * sizeof(Student));
+            for (size_t i = 0; i < j->rows; ++i) {
+                for (size_t c = 0; c < ncols; ++c) {
+                    double v = j->scores[i * j->ncols + c];
+                    if (!isnan(v)) gradebook_load_score(j->arr[i].id, c, v);
+                }
+            }
+            pos += j->rows;
+        }
+        /* the grade of a student with scores is its weighted final */
+        for (size_t i = 0; ncols && i < total; ++i) gradebook_final(arr[i].id, &arr[i].grade);
+    }
+    for (size_t k = 0; k < m.nshards; ++k) {
+        free(m.jobs[k].arr);
+        free(m.jobs[k].scores);
+    }
+    free(m.jobs);
+    if (!arr) {
+        fprintf(stderr, "Error: shards of %s failed validation; nothing loaded\n", filename);
+        load_failed = 1;
+        return;
+    }
+
+    /* the manifest keeps next_id so ids freed at the top are not reused */
+    int next_id = m.next_id;
+    if (next_id <= max_id) next_id = max_id + 1;
+    replace_storage_content(arr, total, next_id);
+    current_generation = m.generation;
+    have_generation = 1;
+    printf("Loaded %zu students from %s (%zu shards)\n", total, filename, m.nshards);
+}
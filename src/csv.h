@@ -1,7 +1,31 @@
 #ifndef CSV_H
 #define CSV_H
 
+#include <stddef.h>
+#include "gradebook.h"
+#include "storage.h"
+
 void save_to_file(const char *filename);
 void load_from_file(const char *filename);
+/* Parse one CSV record (no trailing newline); returns 1 on success */
+int parse_student_line(const char *line, Student *out);
+/* As parse_student_line, also reading ncols score columns after the
+   grade into scores (NAN where a column is empty or absent) */
+int parse_student_scores(const char *line, Student *out, double *scores, size_t ncols);
+/* Assessment columns of a header "id,name,grade,<name>:<weight>,...":
+   the first max go into names and weights (weight 1 when none is given).
+   Returns the number of columns. */
+size_t parse_csv_header(const char *line, char names[][ASSESSMENT_NAME_LEN], double *weights, size_t max);
+/* Parse a delta CSV for command_merge: rows update or insert by id, a
+   row of the form "-<id>" deletes that id. On success returns 0 and hands
+   over a malloc'd array in *rows (NULL when empty); -1 if unreadable or
+   if it has assessment score columns, which merging would drop. */
+int read_delta_file(const char *filename, StudentDelta **rows, size_t *n);
+
+/* Sharded persistence: N shard files written and read in parallel,
+   validated by <filename>.manifest. save_to_file/load_from_file use these
+   when GRADE_SHARDS is set above 1. */
+void save_sharded(const char *filename, size_t nshards);
+void load_sharded(const char *filename);
 
 #endif /* CSV_H */
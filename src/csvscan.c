@@ -0,0 +1,158 @@
+/* src/csvscan.c — vectorized CSV scanning and exact number parsing */
+
+#include <limits.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "csvscan.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define SCAN_SIMD 1
+/* bits of the mask per input byte */
+#define MASK_BITS 1
+
+static inline uint64_t block_mask(const char *p, char a, char b) {
+    __m128i v = _mm_loadu_si128((const __m128i *)p);
+    __m128i m = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(a)),
+                             _mm_cmpeq_epi8(v, _mm_set1_epi8(b)));
+    return (uint64_t)(unsigned)_mm_movemask_epi8(m);
+}
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define SCAN_SIMD 1
+#define MASK_BITS 4
+
+/* NEON has no movemask: narrowing each 16-bit lane by 4 leaves one
+   nibble per byte in a 64-bit value */
+static inline uint64_t block_mask(const char *p, char a, char b) {
+    uint8x16_t v = vld1q_u8((const uint8_t *)p);
+    uint8x16_t m = vorrq_u8(vceqq_u8(v, vdupq_n_u8((uint8_t)a)), vceqq_u8(v, vdupq_n_u8((uint8_t)b)));
+    uint8x8_t nib = vshrn_n_u16(vreinterpretq_u16_u8(m), 4);
+    return vget_lane_u64(vreinterpret_u64_u8(nib), 0);
+}
+#endif
+
+const char *scan_find2(const char *p, const char *end, char a, char b) {
+#ifdef SCAN_SIMD
+    while (end - p >= 16) {
+        uint64_t m = block_mask(p, a, b);
+        if (m) return p + __builtin_ctzll(m) / MASK_BITS;
+        p += 16;
+    }
+#endif
+    while (p < end && *p != a && *p != b) p++;
+    return p;
+}
+
+const char *scan_find1(const char *p, const char *end, char a) {
+    return scan_find2(p, end, a, a);
+}
+
+/* A closing quote must end its field: ',' or the end of the record
+   (newline, CR LF, or the end of the input) */
+static int closes_field(const char *q, const char *end) {
+    const char *a = q + 1;
+    if (a == end || *a == ',' || *a == '\n') return 1;
+    return *a == '\r' && (a + 1 == end || a[1] == '\n');
+}
+
+const char *scan_record_end(const char *p, const char *end) {
+    const char *q = p;
+    for (;;) {
+        q = scan_find2(q, end, '\n', '"');
+        if (q == end || *q == '\n') return q;
+        if (q != p && q[-1] != ',') {
+            q++; /* quote inside an unquoted field: an ordinary byte */
+            continue;
+        }
+        /* quoted field: runs to a lone quote, "" is an escaped quote */
+        const char *c = q + 1;
+        for (;;) {
+            c = scan_find1(c, end, '"');
+            if (end - c > 1 && c[1] == '"') c += 2;
+            else break;
+        }
+        if (c < end && closes_field(c, end)) {
+            q = c + 1;
+            continue;
+        }
+        /* unterminated or followed by stray bytes: not a field that may
+           hold newlines, so the record ends at the first one after the
+           quote and the next record starts cleanly */
+        return scan_find1(q, end, '\n');
+    }
+}
+
+char *scan_next_record(char **cursor, char *end, size_t *len) {
+    char *p = *cursor;
+    for (;;) {
+        if (p >= end) {
+            *cursor = end;
+            return NULL;
+        }
+        char *q = (char *)scan_record_end(p, end);
+        *cursor = q < end ? q + 1 : end;
+        char *stop = q;
+        if (stop > p && stop[-1] == '\r') stop--;
+        if (stop == p) {
+            p = *cursor;
+            continue; /* blank line */
+        }
+        *stop = '\0';
+        *len = (size_t)(stop - p);
+        return p;
+    }
+}
+
+const char *scan_int(const char *p, const char *end, int *out) {
+    const char *start = p;
+    long long v = 0;
+    while (p < end && *p >= '0' && *p <= '9' && p - start < 10) {
+        v = v * 10 + (*p - '0');
+        p++;
+    }
+    if (p == start || v > INT_MAX || (p < end && *p >= '0' && *p <= '9')) return NULL;
+    *out = (int)v;
+    return p;
+}
+
+static const double pow10_tab[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+const char *scan_decimal(const char *p, const char *end, double *out) {
+    int neg = 0;
+    if (p < end && *p == '-') {
+        neg = 1;
+        p++;
+    }
+    uint64_t mant = 0;
+    int digits = 0, frac = 0;
+    const char *start = p;
+    while (p < end && *p >= '0' && *p <= '9') {
+        mant = mant * 10 + (uint64_t)(*p - '0');
+        if (mant) digits++;
+        p++;
+    }
+    int int_digits = (int)(p - start);
+    if (p < end && *p == '.') {
+        p++;
+        while (p < end && *p >= '0' && *p <= '9') {
+            mant = mant * 10 + (uint64_t)(*p - '0');
+            if (mant) digits++;
+            frac++;
+            p++;
+        }
+    }
+    if (int_digits + frac == 0) return NULL;
+    /* 15 digits keep the mantissa below 2^53, and 10^22 is the largest
+       exactly representable power, so the division rounds only once */
+    if (digits > 15 || frac > 22) return NULL;
+    /* an exponent or more digits would change the value: not our form */
+    if (p < end && (*p == 'e' || *p == 'E' || *p == '.')) return NULL;
+    double v = (double)mant / pow10_tab[frac];
+    *out = neg ? -v : v;
+    return p;
+}
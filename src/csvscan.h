@@ -0,0 +1,42 @@
+#ifndef CSVSCAN_H
+#define CSVSCAN_H
+
+/* Low-level CSV scanning used by csv.c.
+
+   The searches test 16 bytes per step (SSE2 on x86-64, NEON on ARM):
+   each block is compared against the wanted characters and the matches
+   are packed into a bitmask whose lowest set bit gives the position.
+   Other targets use a plain byte loop with the same results.
+
+   The number parsers accept only the plain forms our writer produces and
+   return NULL for anything else, so callers can fall back to the general
+   (strtod/atoi) path. */
+
+#include <stddef.h>
+
+/* First byte in [p, end) equal to a (or to a or b); end if none */
+const char *scan_find1(const char *p, const char *end, char a);
+const char *scan_find2(const char *p, const char *end, char a, char b);
+
+/* End of the record starting at p: its terminating newline, or end.
+   A field is quoted only if it starts with a quote; its newlines belong
+   to the record if its closing quote is followed by ',' or the end of
+   the record. Any other quote is an ordinary byte, and a quoted field
+   that is unterminated or closed early ends the record at the first
+   newline after its opening quote, so one stray quote costs at most the
+   record it is in. */
+const char *scan_record_end(const char *p, const char *end);
+/* Split the next non-empty record off [*cursor, end) (see
+   scan_record_end) and NUL-terminate it in place, dropping a CR before
+   the terminating newline. Returns the record (its length in *len) or
+   NULL when no records are left. */
+char *scan_next_record(char **cursor, char *end, size_t *len);
+
+/* Unsigned decimal integer that fits in an int */
+const char *scan_int(const char *p, const char *end, int *out);
+/* [-]digits[.digits] with at most 15 significant digits. The value is
+   mantissa / 10^fraction_digits in one correctly rounded division, which
+   is exactly what strtod returns for the same text. */
+const char *scan_decimal(const char *p, const char *end, double *out);
+
+#endif /* CSVSCAN_H */
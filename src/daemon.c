@@ -0,0 +1,412 @@
+/* src/daemon.c
+   grade_systemd: keeps one in-memory roster and serves it to local
+   clients over a Unix domain socket (see protocol.h). A single epoll loop
+   handles every connection; requests are answered in arrival order, so
+   clients may pipeline. SIGINT/SIGTERM save the data file and exit.
+   Edits other tools make to the data file are merged in as they land.
+
+   Usage: ./grade_systemd [socket_path] [data_file]
+*/
+
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "storage.h"
+#include "csv.h"
+#include "protocol.h"
+#include "threadpool.h"
+#include "watch.h"
+
+#define DATA_FILE "data/students.csv"
+#define MAX_EVENTS 64
+#define READ_CHUNK 65536
+/* stop decoding (and reading) requests for a client until it reads its
+   replies */
+#define OUT_HIGH_WATER (4u << 20)
+
+typedef struct Conn {
+    int fd;
+    ProtoBuf in;
+    ProtoBuf out;
+    uint32_t events; /* epoll events currently registered */
+    struct Conn *prev;
+    struct Conn *next;
+} Conn;
+
+static const char *data_file = DATA_FILE;
+static int epfd = -1;
+static Conn *conns = NULL;
+/* bumped on every change to the roster or its order (see LIST_PAGE) */
+static uint32_t generation = 0;
+/* epoll tags for the non-client descriptors */
+static char listen_tag;
+static char signal_tag;
+static char watch_tag;
+
+static int set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags < 0 ? -1 : fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+/* ---- request handling ---- */
+
+typedef struct {
+    const char *needle;
+    ProtoBuf *out;
+    uint32_t limit;
+    uint32_t found;
+} SearchCtx;
+
+/* ASCII case-insensitive substring test */
+static int name_contains(const char *name, const char *needle) {
+    size_t n = strlen(needle);
+    if (n == 0) return 1;
+    for (; *name; ++name) {
+        if (strncasecmp(name, needle, n) == 0) return 1;
+    }
+    return 0;
+}
+
+static int search_visit(const Student *s, void *user) {
+    SearchCtx *ctx = user;
+    if (!name_contains(s->name, ctx->needle)) return 0;
+    pbuf_put_student(ctx->out, s);
+    return ++ctx->found >= ctx->limit;
+}
+
+/* Append the reply for one request to out and return its status */
+static int handle_request(const ProtoHeader *h, ProtoReader *r, ProtoBuf *out) {
+    char name[NAME_LENGTH];
+
+    switch (h->op) {
+    case OP_ADD: {
+        double grade = preader_f64(r);
+        preader_str(r, name, sizeof(name));
+        if (r->err || name[0] == '\0') return STATUS_BAD_REQUEST;
+        add_student(name, grade);
+        generation++;
+        pbuf_put_i32(out, get_storage_next_id() - 1);
+        return STATUS_OK;
+    }
+    case OP_REMOVE: {
+        int id = preader_i32(r);
+        if (r->err) return STATUS_BAD_REQUEST;
+        if (!find_student(id)) return STATUS_NOT_FOUND;
+        remove_student(id);
+        generation++;
+        return STATUS_OK;
+    }
+    case OP_LIST_PAGE: {
+        size_t offset = preader_u32(r);
+        size_t limit = preader_u32(r);
+        if (r->err) return STATUS_BAD_REQUEST;
+        if (limit > PROTO_MAX_PAGE) limit = PROTO_MAX_PAGE;
+        const Student *arr = get_storage_array();
+        size_t total = get_storage_count();
+        size_t n = offset < total ? total - offset : 0;
+        if (n > limit) n = limit;
+        pbuf_put_u32(out, generation);
+        pbuf_put_u32(out, (uint32_t)total);
+        pbuf_put_u32(out, (uint32_t)n);
+        for (size_t i = 0; i < n; ++i) pbuf_put_student(out, &arr[offset + i]);
+        return STATUS_OK;
+    }
+    case OP_STATS:
+        pbuf_put_u32(out, (uint32_t)get_storage_count());
+        pbuf_put_f64(out, compute_average());
+        return STATUS_OK;
+    case OP_SEARCH: {
+        uint32_t limit = preader_u32(r);
+        preader_str(r, name, sizeof(name));
+        if (r->err) return STATUS_BAD_REQUEST;
+        if (limit == 0 || limit > PROTO_MAX_PAGE) limit = PROTO_MAX_PAGE;
+        size_t count_off = out->len;
+        pbuf_put_u32(out, 0);
+        SearchCtx ctx = { name, out, limit, 0 };
+        storage_foreach(search_visit, &ctx);
+        memcpy(out->data + count_off, &ctx.found, sizeof(ctx.found));
+        return STATUS_OK;
+    }
+    case OP_SORT: {
+        uint8_t order = preader_u8(r);
+        if (r->err) return STATUS_BAD_REQUEST;
+        if (order == SORT_ORDER_NAME) sort_by_name();
+        else if (order == SORT_ORDER_GRADE_DESC) sort_by_grade_desc();
+        else return STATUS_BAD_REQUEST;
+        generation++;
+        return STATUS_OK;
+    }
+    case OP_SAVE:
+        save_to_file(data_file);
+        return STATUS_OK;
+    default:
+        return STATUS_BAD_REQUEST;
+    }
+}
+
+/* ---- connections ---- */
+
+static void close_conn(Conn *c) {
+    epoll_ctl(epfd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    if (c->prev) c->prev->next = c->next;
+    else conns = c->next;
+    if (c->next) c->next->prev = c->prev;
+    pbuf_free(&c->in);
+    pbuf_free(&c->out);
+    free(c);
+}
+
+/* Wait for output space while replies are pending, and for input only
+   while the replies are below the high-water mark: a client that sends
+   without reading is left to fill its own socket buffers, not ours. */
+static void update_events(Conn *c) {
+    uint32_t events = (c->out.len < OUT_HIGH_WATER ? EPOLLIN : 0) | (c->out.len > 0 ? EPOLLOUT : 0);
+    if (c->events == events) return;
+    struct epoll_event ev;
+    ev.events = events;
+    ev.data.ptr = c;
+    epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &ev);
+    c->events = events;
+}
+
+/* Decode and answer every complete request in the input buffer.
+   Returns -1 if the client sent something unframeable. */
+static int process_input(Conn *c) {
+    size_t pos = 0;
+    while (c->in.len - pos >= PROTO_HEADER_SIZE && c->out.len < OUT_HIGH_WATER) {
+        ProtoHeader h;
+        proto_read_header(c->in.data + pos, &h);
+        if (h.len > PROTO_MAX_PAYLOAD) return -1;
+        if (c->in.len - pos < PROTO_HEADER_SIZE + h.len) break;
+
+        ProtoReader r;
+        preader_init(&r, c->in.data + pos + PROTO_HEADER_SIZE, h.len);
+        size_t off = proto_begin_message(&c->out, h.op, STATUS_OK, h.seq);
+        int status = handle_request(&h, &r, &c->out);
+        if (status != STATUS_OK) {
+            /* error replies carry no payload */
+            c->out.len = off + PROTO_HEADER_SIZE;
+            c->out.data[off + 9] = (unsigned char)status;
+        }
+        proto_end_message(&c->out, off);
+        pos += PROTO_HEADER_SIZE + h.len;
+    }
+    pbuf_consume(&c->in, pos);
+    return 0;
+}
+
+/* Write as much pending output as the socket takes. Returns -1 on error. */
+static int flush_output(Conn *c) {
+    size_t off = 0;
+    while (off < c->out.len) {
+        ssize_t n = send(c->fd, c->out.data + off, c->out.len - off, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            return -1;
+        }
+        off += (size_t)n;
+    }
+    pbuf_consume(&c->out, off);
+    update_events(c);
+    return 0;
+}
+
+/* Requests are decoded after every chunk, so the input buffer holds at
+   most one chunk plus a partial request; once the replies pass the
+   high-water mark the rest stays in the socket until on_writable drains
+   them. */
+static void on_readable(Conn *c) {
+    int eof = 0;
+    while (c->out.len < OUT_HIGH_WATER) {
+        pbuf_reserve(&c->in, READ_CHUNK);
+        ssize_t n = read(c->fd, c->in.data + c->in.len, c->in.cap - c->in.len);
+        if (n > 0) {
+            c->in.len += (size_t)n;
+            if (process_input(c) != 0) {
+                close_conn(c);
+                return;
+            }
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        eof = 1; /* EOF or error: answer what already arrived, then close */
+        break;
+    }
+    if (process_input(c) != 0 || flush_output(c) != 0 || eof) close_conn(c);
+}
+
+static void on_writable(Conn *c) {
+    if (flush_output(c) != 0) {
+        close_conn(c);
+        return;
+    }
+    /* requests held back by the high-water mark can run now; reading
+       resumes (update_events) once the replies drop below it */
+    if (c->in.len > 0 && (process_input(c) != 0 || flush_output(c) != 0)) close_conn(c);
+}
+
+static void accept_clients(int lfd) {
+    for (;;) {
+        int fd = accept(lfd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) perror("accept");
+            return;
+        }
+        Conn *c = calloc(1, sizeof(Conn));
+        if (!c || set_nonblocking(fd) != 0) {
+            fprintf(stderr, "Dropping client: setup failed\n");
+            free(c);
+            close(fd);
+            continue;
+        }
+        c->fd = fd;
+        c->events = EPOLLIN;
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.ptr = c;
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            perror("epoll_ctl");
+            free(c);
+            close(fd);
+            continue;
+        }
+        c->next = conns;
+        if (conns) conns->prev = c;
+        conns = c;
+    }
+}
+
+/* ---- setup ---- */
+
+static int open_listener(const char *path) {
+    struct sockaddr_un addr;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Socket path too long: %s\n", path);
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    /* refuse to start twice; otherwise clear a stale socket file */
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
+        fprintf(stderr, "grade_systemd is already running on %s\n", path);
+        close(fd);
+        return -1;
+    }
+    unlink(path);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, SOMAXCONN) != 0 ||
+        set_nonblocking(fd) != 0) {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int main(int argc, char *argv[]) {
+    const char *socket_path = argc > 1 ? argv[1] : PROTO_DEFAULT_SOCKET;
+    if (argc > 2) data_file = argv[2];
+
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    sigprocmask(SIG_BLOCK, &mask, NULL);
+    signal(SIGPIPE, SIG_IGN);
+    int sfd = signalfd(-1, &mask, 0);
+
+    int lfd = open_listener(socket_path);
+    epfd = epoll_create1(0);
+    if (sfd < 0 || lfd < 0 || epfd < 0) {
+        if (sfd < 0 || epfd < 0) perror("grade_systemd");
+        return EXIT_FAILURE;
+    }
+
+    init_storage();
+    load_from_file(data_file);
+    storage_set_quiet(1);
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = &listen_tag;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, lfd, &ev);
+    ev.data.ptr = &signal_tag;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, sfd, &ev);
+    int wfd = watch_start(data_file);
+    if (wfd >= 0) {
+        ev.data.ptr = &watch_tag;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, wfd, &ev);
+    }
+
+    printf("grade_systemd: serving %zu students on %s (%s storage)\n",
+           get_storage_count(), socket_path, storage_backend_name());
+    fflush(stdout);
+
+    int running = 1;
+    struct epoll_event events[MAX_EVENTS];
+    while (running) {
+        int n = epoll_wait(epfd, events, MAX_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait");
+            break;
+        }
+        for (int i = 0; i < n; ++i) {
+            void *tag = events[i].data.ptr;
+            if (tag == &listen_tag) {
+                accept_clients(lfd);
+            } else if (tag == &signal_tag) {
+                running = 0;
+            } else if (tag == &watch_tag) {
+                size_t changed = watch_poll(NULL, NULL);
+                if (changed) {
+                    generation++;
+                    printf("grade_systemd: applied %zu changes from %s\n", changed, data_file);
+                    fflush(stdout);
+                }
+            } else {
+                Conn *c = tag;
+                if (events[i].events & (EPOLLERR | EPOLLHUP) && !(events[i].events & EPOLLIN)) {
+                    close_conn(c);
+                } else if (events[i].events & EPOLLIN) {
+                    on_readable(c);
+                } else if (events[i].events & EPOLLOUT) {
+                    on_writable(c);
+                }
+            }
+        }
+    }
+
+    puts("grade_systemd: shutting down");
+    save_to_file(data_file);
+    while (conns) close_conn(conns);
+    watch_stop();
+    close(lfd);
+    close(sfd);
+    close(epfd);
+    unlink(socket_path);
+    free_storage();
+    pool_shutdown();
+    return 0;
+}
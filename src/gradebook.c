@@ -0,0 +1,267 @@
+/* src/gradebook.c — column-wise assessment scores and weighted finals */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gradebook.h"
+#include "storage.h"
+
+#define NO_ROW SIZE_MAX
+
+static size_t nassess = 0;
+static char names[MAX_ASSESSMENTS][ASSESSMENT_NAME_LEN];
+static double weights[MAX_ASSESSMENTS];
+
+/* Row r of every column belongs to student row_id[r]. Missing scores are
+   NAN so a column stays dense and branch-free to scan. */
+static size_t rows = 0;
+static size_t row_cap = 0;
+static int *row_id = NULL;
+static double *scores[MAX_ASSESSMENTS];
+static double *finals = NULL; /* NAN when the row has no usable score */
+
+/* id -> row, open addressing with linear probing */
+static size_t *slots = NULL;
+static size_t slot_mask = 0;
+
+static void *xrealloc(void *p, size_t n) {
+    void *tmp = realloc(p, n);
+    if (!tmp) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    return tmp;
+}
+
+static size_t hash_id(int id) {
+    return (size_t)((unsigned int)id * 2654435761u);
+}
+
+static size_t slot_of(int id) {
+    size_t h = hash_id(id) & slot_mask;
+    while (slots[h] != NO_ROW && row_id[slots[h]] != id) h = (h + 1) & slot_mask;
+    return h;
+}
+
+static size_t find_row(int id) {
+    return slots ? slots[slot_of(id)] : NO_ROW;
+}
+
+static void rehash(size_t cap) {
+    free(slots);
+    slots = xrealloc(NULL, cap * sizeof(size_t));
+    for (size_t i = 0; i < cap; ++i) slots[i] = NO_ROW;
+    slot_mask = cap - 1;
+    for (size_t r = 0; r < rows; ++r) slots[slot_of(row_id[r])] = r;
+}
+
+static size_t add_row(int id) {
+    if (rows == row_cap) {
+        row_cap = row_cap ? row_cap * 2 : 64;
+        row_id = xrealloc(row_id, row_cap * sizeof(int));
+        finals = xrealloc(finals, row_cap * sizeof(double));
+        for (size_t k = 0; k < nassess; ++k)
+            scores[k] = xrealloc(scores[k], row_cap * sizeof(double));
+    }
+    if (!slots || (rows + 1) * 2 > slot_mask + 1) {
+        size_t cap = 16;
+        while (cap < (rows + 1) * 2) cap *= 2;
+        rehash(cap);
+    }
+    size_t r = rows++;
+    row_id[r] = id;
+    finals[r] = NAN;
+    for (size_t k = 0; k < nassess; ++k) scores[k][r] = NAN;
+    slots[slot_of(id)] = r;
+    return r;
+}
+
+/* Backward-shift deletion keeps probe chains intact without tombstones */
+static void unlink_slot(size_t i) {
+    slots[i] = NO_ROW;
+    for (size_t j = (i + 1) & slot_mask; slots[j] != NO_ROW; j = (j + 1) & slot_mask) {
+        size_t home = hash_id(row_id[slots[j]]) & slot_mask;
+        /* move j back into the hole unless its home lies in (i, j] */
+        int stays = i <= j ? (home > i && home <= j) : (home > i || home <= j);
+        if (stays) continue;
+        slots[i] = slots[j];
+        slots[j] = NO_ROW;
+        i = j;
+    }
+}
+
+void gradebook_remove(int id) {
+    if (!slots) return;
+    size_t s = slot_of(id);
+    size_t r = slots[s];
+    if (r == NO_ROW) return;
+    unlink_slot(s);
+    /* fill the gap with the last row */
+    size_t last = --rows;
+    if (r != last) {
+        row_id[r] = row_id[last];
+        finals[r] = finals[last];
+        for (size_t k = 0; k < nassess; ++k) scores[k][r] = scores[k][last];
+        slots[slot_of(row_id[r])] = r;
+    }
+}
+
+void gradebook_clear(void) {
+    for (size_t k = 0; k < nassess; ++k) {
+        free(scores[k]);
+        scores[k] = NULL;
+    }
+    free(row_id);
+    free(finals);
+    free(slots);
+    row_id = NULL;
+    finals = NULL;
+    slots = NULL;
+    slot_mask = 0;
+    rows = 0;
+    row_cap = 0;
+    nassess = 0;
+}
+
+size_t gradebook_count(void) { return nassess; }
+
+const char *gradebook_name(size_t k) { return k < nassess ? names[k] : ""; }
+
+double gradebook_weight(size_t k) { return k < nassess ? weights[k] : 0.0; }
+
+int gradebook_find(const char *name) {
+    for (size_t k = 0; k < nassess; ++k) {
+        if (strcmp(names[k], name) == 0) return (int)k;
+    }
+    return -1;
+}
+
+int gradebook_add_assessment(const char *name, double weight) {
+    if (!name || !name[0] || strpbrk(name, ",:\"\n") || nassess == MAX_ASSESSMENTS) return -1;
+    if (strlen(name) >= ASSESSMENT_NAME_LEN || gradebook_find(name) >= 0) return -1;
+    size_t k = nassess;
+    strcpy(names[k], name);
+    weights[k] = weight;
+    scores[k] = xrealloc(NULL, (row_cap ? row_cap : 1) * sizeof(double));
+    for (size_t r = 0; r < rows; ++r) scores[k][r] = NAN;
+    nassess++;
+    return (int)k;
+}
+
+/* Weighted finals for every row, one pass per column. The loops are
+   written without branches on the data so the compiler can vectorize. */
+static void compute_finals(void) {
+    if (rows == 0) return;
+    double *den = xrealloc(NULL, rows * sizeof(double));
+    double *num = finals;
+    for (size_t r = 0; r < rows; ++r) {
+        num[r] = 0.0;
+        den[r] = 0.0;
+    }
+    for (size_t k = 0; k < nassess; ++k) {
+        const double w = weights[k];
+        const double *col = scores[k];
+        for (size_t r = 0; r < rows; ++r) {
+            double s = col[r];
+            int have = s == s; /* false for NAN */
+            num[r] += have ? w * s : 0.0;
+            den[r] += have ? w : 0.0;
+        }
+    }
+    for (size_t r = 0; r < rows; ++r) num[r] = den[r] > 0.0 ? num[r] / den[r] : NAN;
+    free(den);
+}
+
+static double row_final(size_t r) {
+    double num = 0.0, den = 0.0;
+    for (size_t k = 0; k < nassess; ++k) {
+        double s = scores[k][r];
+        if (s != s) continue;
+        num += weights[k] * s;
+        den += weights[k];
+    }
+    return den > 0.0 ? num / den : NAN;
+}
+
+typedef struct {
+    StudentDelta *items;
+    size_t count;
+    size_t cap;
+} Updates;
+
+static int collect_update(const Student *s, void *user) {
+    Updates *u = user;
+    size_t r = find_row(s->id);
+    if (r == NO_ROW || finals[r] != finals[r] || finals[r] == s->grade) return 0;
+    if (u->count == u->cap) {
+        u->cap = u->cap ? u->cap * 2 : 64;
+        u->items = xrealloc(u->items, u->cap * sizeof(StudentDelta));
+    }
+    u->items[u->count].rec = *s;
+    u->items[u->count].rec.grade = finals[r];
+    u->items[u->count].tombstone = 0;
+    u->count++;
+    return 0;
+}
+
+void gradebook_recompute(void) {
+    if (storage_get_backend() == STORAGE_BACKEND_REMOTE) return;
+    compute_finals();
+    Updates u = { NULL, 0, 0 };
+    storage_foreach(collect_update, &u);
+    if (u.count) storage_merge(u.items, u.count, NULL);
+    free(u.items);
+}
+
+int gradebook_load_weight(size_t k, double weight) {
+    if (k >= nassess || weight < 0.0) return -1;
+    weights[k] = weight;
+    return 0;
+}
+
+int gradebook_set_weight(size_t k, double weight) {
+    if (gradebook_load_weight(k, weight) != 0) return -1;
+    gradebook_recompute();
+    return 0;
+}
+
+int gradebook_load_score(int id, size_t k, double score) {
+    if (k >= nassess || id <= 0) return -1;
+    size_t r = find_row(id);
+    if (r == NO_ROW) {
+        if (score != score) return 0;
+        r = add_row(id);
+    }
+    scores[k][r] = score;
+    finals[r] = row_final(r);
+    return 0;
+}
+
+double gradebook_score(int id, size_t k) {
+    size_t r = find_row(id);
+    if (k >= nassess || r == NO_ROW) return NAN;
+    return scores[k][r];
+}
+
+double gradebook_average(size_t k) {
+    if (k >= nassess) return NAN;
+    const double *col = scores[k];
+    double sum = 0.0, n = 0.0;
+    for (size_t r = 0; r < rows; ++r) {
+        double s = col[r];
+        int have = s == s;
+        sum += have ? s : 0.0;
+        n += have ? 1.0 : 0.0;
+    }
+    return n > 0.0 ? sum / n : NAN;
+}
+
+int gradebook_final(int id, double *out) {
+    size_t r = find_row(id);
+    if (r == NO_ROW || finals[r] != finals[r]) return 0;
+    if (out) *out = finals[r];
+    return 1;
+}
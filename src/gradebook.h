@@ -0,0 +1,51 @@
+#ifndef GRADEBOOK_H
+#define GRADEBOOK_H
+
+/* Named assessments (midterm, final exam, ...) with per-assessment
+   weights. Scores are stored column-wise: one contiguous array of doubles
+   per assessment, indexed by the same row for every column, so averages
+   and weighted finals are plain loops over arrays.
+
+   A student's Student.grade is its weighted final: the weighted mean of
+   the scores it has (missing scores are left out and the remaining
+   weights renormalized). Students without any score keep the grade they
+   were given. Rows follow the roster: removing a student drops its row. */
+
+#include <stddef.h>
+
+#define MAX_ASSESSMENTS 16
+#define ASSESSMENT_NAME_LEN 32
+
+size_t gradebook_count(void);
+const char *gradebook_name(size_t k);
+double gradebook_weight(size_t k);
+/* Index of the assessment called name, or -1 */
+int gradebook_find(const char *name);
+/* Returns the new index, or -1 if the name is empty, taken, contains
+   ',' or ':' (the CSV header uses them) or the table is full. */
+int gradebook_add_assessment(const char *name, double weight);
+/* Change a weight and recompute every weighted final; 0 on success.
+   Not recorded for undo: live reload uses it, which clears the history;
+   edits go through command_set_weight and command_set_score. */
+int gradebook_set_weight(size_t k, double weight);
+
+/* NAN when the student has no score for k */
+double gradebook_score(int id, size_t k);
+/* Mean of the recorded scores for k, NAN if there are none */
+double gradebook_average(size_t k);
+
+/* Recompute all weighted finals and write them into storage */
+void gradebook_recompute(void);
+/* Weighted final as of the last change; returns 0 if id has no scores */
+int gradebook_final(int id, double *out);
+
+/* Used by storage.c and csv.c */
+void gradebook_remove(int id);
+void gradebook_clear(void);
+/* Set a score without touching storage (bulk load); 0 on success */
+int gradebook_load_score(int id, size_t k, double score);
+/* Set a weight without recomputing finals (command.c recomputes once per
+   batch); 0 on success */
+int gradebook_load_weight(size_t k, double weight);
+
+#endif /* GRADEBOOK_H */
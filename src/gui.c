@@ -5,35 +5,51 @@
 
 #define _POSIX_C_SOURCE 200809L
 #include <gtk/gtk.h>
+#include <glib-unix.h>
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "storage.h"
 #include "csv.h"
+#include "command.h"
+#include "watch.h"
+#include "gradebook.h"
 
-/* Columns in the GtkListStore */
+/* Columns in the GtkListStore; one score string per assessment follows */
 enum {
     COL_ID = 0,
     COL_NAME,
     COL_GRADE_STR,
     N_COLUMNS
 };
+#define COL_SCORE(k) (N_COLUMNS + (int)(k))
 
 /* Small context passed to callbacks */
 typedef struct {
     GtkListStore *store;
     GtkWidget *tree;
+    GtkWidget *btn_undo;
+    GtkWidget *btn_redo;
+    guint refresh_tick; /* pending frame callback, 0 if none */
 } AppContext;
 
 /* Forward declarations */
 static void refresh_list(AppContext *ctx);
+static void schedule_refresh(AppContext *ctx);
+static void on_commands_changed(void *user);
 static void on_add(GtkButton *button, gpointer user_data);
 static void on_remove(GtkButton *button, gpointer user_data);
 static void on_save(GtkButton *button, gpointer user_data);
 static void on_sort_name(GtkButton *button, gpointer user_data);
 static void on_sort_grade(GtkButton *button, gpointer user_data);
 static void on_average(GtkButton *button, gpointer user_data);
+static void on_merge(GtkButton *button, gpointer user_data);
+static void on_undo(GtkButton *button, gpointer user_data);
+static void on_redo(GtkButton *button, gpointer user_data);
+static gboolean on_data_file_changed(gint fd, GIOCondition cond, gpointer user_data);
+static void on_score_edited(GtkCellRendererText *renderer, gchar *path, gchar *text, gpointer user_data);
 
 /* Build the main window */
 GtkWidget *build_main_window(void) {
@@ -55,6 +71,9 @@ GtkWidget *build_main_window(void) {
     GtkWidget *btn_save = gtk_button_new_with_label("Save");
     GtkWidget *btn_sort_name = gtk_button_new_with_label("Sort by Name");
     GtkWidget *btn_sort_grade = gtk_button_new_with_label("Sort by Grade");
+    GtkWidget *btn_merge = gtk_button_new_with_label("Merge...");
+    GtkWidget *btn_undo = gtk_button_new_with_label("Undo");
+    GtkWidget *btn_redo = gtk_button_new_with_label("Redo");
     GtkWidget *btn_avg = gtk_button_new_with_label("Average");
 
     gtk_box_pack_start(GTK_BOX(hbox), btn_add, FALSE, FALSE, 0);
@@ -62,6 +81,9 @@ GtkWidget *build_main_window(void) {
     gtk_box_pack_start(GTK_BOX(hbox), btn_save, FALSE, FALSE, 0);
     gtk_box_pack_start(GTK_BOX(hbox), btn_sort_name, FALSE, FALSE, 0);
     gtk_box_pack_start(GTK_BOX(hbox), btn_sort_grade, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(hbox), btn_merge, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(hbox), btn_undo, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(hbox), btn_redo, FALSE, FALSE, 0);
     gtk_box_pack_end(GTK_BOX(hbox), btn_avg, FALSE, FALSE, 0);
 
     /* Scrolled window with treeview */
@@ -72,10 +94,15 @@ GtkWidget *build_main_window(void) {
     gtk_widget_set_vexpand(scrolled, TRUE);
     gtk_box_pack_start(GTK_BOX(vbox), scrolled, TRUE, TRUE, 0);
 
-    /* Use strings for name and grade display (simple and portable) */
-    GtkListStore *store = gtk_list_store_new(N_COLUMNS, G_TYPE_INT, G_TYPE_STRING, G_TYPE_STRING);
+    /* Use strings for name, grade and score display (simple and portable) */
+    GType types[N_COLUMNS + MAX_ASSESSMENTS];
+    types[COL_ID] = G_TYPE_INT;
+    for (int i = COL_NAME; i < N_COLUMNS + MAX_ASSESSMENTS; ++i) types[i] = G_TYPE_STRING;
+    GtkListStore *store = gtk_list_store_newv(N_COLUMNS + (gint)gradebook_count(), types);
     GtkWidget *tree = gtk_tree_view_new_with_model(GTK_TREE_MODEL(store));
     gtk_container_add(GTK_CONTAINER(scrolled), tree);
+    /* Remove acts on every selected row as one batch */
+    gtk_tree_selection_set_mode(gtk_tree_view_get_selection(GTK_TREE_VIEW(tree)), GTK_SELECTION_MULTIPLE);
 
     /* Columns */
     GtkCellRenderer *renderer;
@@ -99,6 +126,20 @@ GtkWidget *build_main_window(void) {
     AppContext *ctx = g_new0(AppContext, 1);
     ctx->store = store;
     ctx->tree = tree;
+    ctx->btn_undo = btn_undo;
+    ctx->btn_redo = btn_redo;
+
+    /* One editable column per assessment; the weighted final is Grade */
+    for (size_t k = 0; k < gradebook_count(); ++k) {
+        char title[ASSESSMENT_NAME_LEN + 32];
+        snprintf(title, sizeof(title), "%s (%g)", gradebook_name(k), gradebook_weight(k));
+        renderer = gtk_cell_renderer_text_new();
+        g_object_set(renderer, "editable", TRUE, NULL);
+        g_object_set_data(G_OBJECT(renderer), "assessment", GSIZE_TO_POINTER(k));
+        g_signal_connect(renderer, "edited", G_CALLBACK(on_score_edited), ctx);
+        GtkTreeViewColumn *col = gtk_tree_view_column_new_with_attributes(title, renderer, "text", COL_SCORE(k), NULL);
+        gtk_tree_view_append_column(GTK_TREE_VIEW(tree), col);
+    }
 
     /* Connect signals */
     g_signal_connect(btn_add, "clicked", G_CALLBACK(on_add), ctx);
@@ -106,40 +147,101 @@ GtkWidget *build_main_window(void) {
     g_signal_connect(btn_save, "clicked", G_CALLBACK(on_save), ctx);
     g_signal_connect(btn_sort_name, "clicked", G_CALLBACK(on_sort_name), ctx);
     g_signal_connect(btn_sort_grade, "clicked", G_CALLBACK(on_sort_grade), ctx);
+    g_signal_connect(btn_merge, "clicked", G_CALLBACK(on_merge), ctx);
     g_signal_connect(btn_avg, "clicked", G_CALLBACK(on_average), ctx);
+    g_signal_connect(btn_undo, "clicked", G_CALLBACK(on_undo), ctx);
+    g_signal_connect(btn_redo, "clicked", G_CALLBACK(on_redo), ctx);
+
+    /* Ctrl+Z / Ctrl+Shift+Z */
+    GtkAccelGroup *accel = gtk_accel_group_new();
+    gtk_window_add_accel_group(GTK_WINDOW(window), accel);
+    gtk_widget_add_accelerator(btn_undo, "clicked", accel, GDK_KEY_z, GDK_CONTROL_MASK, GTK_ACCEL_VISIBLE);
+    gtk_widget_add_accelerator(btn_redo, "clicked", accel, GDK_KEY_z, GDK_CONTROL_MASK | GDK_SHIFT_MASK,
+                               GTK_ACCEL_VISIBLE);
+
+    /* Every committed batch, undo or redo ends in one coalesced refresh */
+    command_set_listener(on_commands_changed, ctx);
 
     /* When window is closed, quit GTK loop (we save in main before exit) */
     g_signal_connect(window, "destroy", G_CALLBACK(gtk_main_quit), NULL);
 
+    /* Apply outside edits to the data file as they land */
+    if (watch_fd() >= 0)
+        g_unix_fd_add(watch_fd(), G_IO_IN, on_data_file_changed, ctx);
+
     /* Initial fill */
     refresh_list(ctx);
 
     return window;
 }
 
-/* Helper: refresh list store from storage */
+static void set_row(GtkListStore *store, GtkTreeIter *iter, const Student *s) {
+    char gradebuf[32];
+    snprintf(gradebuf, sizeof(gradebuf), "%.2f", s->grade);
+    gtk_list_store_set(store, iter,
+                       COL_ID, s->id,
+                       COL_NAME, s->name,
+                       COL_GRADE_STR, gradebuf,
+                       -1);
+    for (size_t k = 0; k < gradebook_count(); ++k) {
+        double v = gradebook_score(s->id, k);
+        if (isnan(v)) gradebuf[0] = '\0';
+        else snprintf(gradebuf, sizeof(gradebuf), "%.2f", v);
+        gtk_list_store_set(store, iter, COL_SCORE(k), gradebuf, -1);
+    }
+}
+
+static int append_row(const Student *s, void *user) {
+    GtkListStore *store = user;
+    GtkTreeIter iter;
+    gtk_list_store_append(store, &iter);
+    set_row(store, &iter, s);
+    return 0;
+}
+
+/* Helper: refresh list store from storage. The model is detached while
+   it is rebuilt so the view does not process one signal per row. */
 static void refresh_list(AppContext *ctx) {
+    GtkTreeView *view = GTK_TREE_VIEW(ctx->tree);
+    g_object_ref(ctx->store);
+    gtk_tree_view_set_model(view, NULL);
     gtk_list_store_clear(ctx->store);
-    Student *arr = get_storage_array();
-    size_t cnt = get_storage_count();
-    for (size_t i = 0; i < cnt; ++i) {
-        GtkTreeIter iter;
-        char gradebuf[32];
-        snprintf(gradebuf, sizeof(gradebuf), "%.2f", arr[i].grade);
-        gtk_list_store_append(ctx->store, &iter);
-        gtk_list_store_set(ctx->store, &iter,
-                           COL_ID, arr[i].id,
-                           COL_NAME, arr[i].name,
-                           COL_GRADE_STR, gradebuf,
-                           -1);
+    storage_foreach(append_row, ctx->store);
+    gtk_tree_view_set_model(view, GTK_TREE_MODEL(ctx->store));
+    g_object_unref(ctx->store);
+    gtk_widget_set_sensitive(ctx->btn_undo, command_can_undo());
+    gtk_widget_set_sensitive(ctx->btn_redo, command_can_redo());
+}
+
+static gboolean refresh_on_frame(GtkWidget *widget, GdkFrameClock *clock, gpointer user_data) {
+    (void)widget;
+    (void)clock;
+    AppContext *ctx = (AppContext *)user_data;
+    ctx->refresh_tick = 0;
+    refresh_list(ctx);
+    return G_SOURCE_REMOVE;
+}
+
+/* Rebuild the list on the next frame; further requests until then are
+   folded into it, so a burst of changes costs one refresh. */
+static void schedule_refresh(AppContext *ctx) {
+    if (ctx->refresh_tick) return;
+    if (!gtk_widget_get_mapped(ctx->tree)) {
+        refresh_list(ctx); /* no frames before the window is shown */
+        return;
     }
+    ctx->refresh_tick = gtk_widget_add_tick_callback(ctx->tree, refresh_on_frame, ctx, NULL);
+}
+
+static void on_commands_changed(void *user) {
+    schedule_refresh((AppContext *)user);
 }
 
 /* Dialog: add a new student */
 static void on_add(GtkButton *button, gpointer user_data) {
     /* avoid unused-parameter warnings */
     (void)button;
-    AppContext *ctx = (AppContext *)user_data;
+    (void)user_data;
 
     GtkWidget *dialog = gtk_dialog_new_with_buttons("Add Student",
                                                     NULL,
@@ -172,8 +274,8 @@ static void on_add(GtkButton *button, gpointer user_data) {
         const char *grade_text = gtk_entry_get_text(GTK_ENTRY(ent_grade));
         double g = atof(grade_text);
         if (name && name[0] != '\0' && g >= 0 && g <= 100) {
-            add_student(name, g);
-            refresh_list(ctx);
+            command_add(name, g);
+            command_commit(NULL);
         } else {
             GtkWidget *err = gtk_message_dialog_new(NULL, GTK_DIALOG_MODAL, GTK_MESSAGE_WARNING, GTK_BUTTONS_OK,
                                                     "Invalid input. Name must not be empty and grade must be 0-100.");
@@ -185,7 +287,7 @@ static void on_add(GtkButton *button, gpointer user_data) {
     gtk_widget_destroy(dialog);
 }
 
-/* Remove selected student */
+/* Remove the selected students in one batch */
 static void on_remove(GtkButton *button, gpointer user_data) {
     (void)button;
     AppContext *ctx = (AppContext *)user_data;
@@ -193,26 +295,37 @@ static void on_remove(GtkButton *button, gpointer user_data) {
 
     GtkTreeSelection *sel = gtk_tree_view_get_selection(GTK_TREE_VIEW(tree));
     GtkTreeModel *model;
-    GtkTreeIter iter;
-    if (gtk_tree_selection_get_selected(sel, &model, &iter)) {
-        int id = 0;
-        gtk_tree_model_get(model, &iter, COL_ID, &id, -1);
-        /* Confirm */
-        char msg[128];
-        snprintf(msg, sizeof(msg), "Delete student with ID %d?", id);
-        GtkWidget *confirm = gtk_message_dialog_new(NULL, GTK_DIALOG_MODAL, GTK_MESSAGE_QUESTION, GTK_BUTTONS_YES_NO, "%s", msg);
-        gint resp = gtk_dialog_run(GTK_DIALOG(confirm));
-        gtk_widget_destroy(confirm);
-        if (resp == GTK_RESPONSE_YES) {
-            remove_student(id);
-            refresh_list(ctx);
-        }
-    } else {
+    GList *paths = gtk_tree_selection_get_selected_rows(sel, &model);
+    guint n = g_list_length(paths);
+    if (n == 0) {
         GtkWidget *info = gtk_message_dialog_new(NULL, GTK_DIALOG_MODAL, GTK_MESSAGE_INFO, GTK_BUTTONS_OK,
                                                  "No student selected.");
         gtk_dialog_run(GTK_DIALOG(info));
         gtk_widget_destroy(info);
+        return;
+    }
+
+    /* Confirm */
+    char msg[128];
+    int first_id = 0;
+    GtkTreeIter iter;
+    if (gtk_tree_model_get_iter(model, &iter, paths->data))
+        gtk_tree_model_get(model, &iter, COL_ID, &first_id, -1);
+    if (n == 1) snprintf(msg, sizeof(msg), "Delete student with ID %d?", first_id);
+    else snprintf(msg, sizeof(msg), "Delete %u selected students?", n);
+    GtkWidget *confirm = gtk_message_dialog_new(NULL, GTK_DIALOG_MODAL, GTK_MESSAGE_QUESTION, GTK_BUTTONS_YES_NO, "%s", msg);
+    gint resp = gtk_dialog_run(GTK_DIALOG(confirm));
+    gtk_widget_destroy(confirm);
+    if (resp == GTK_RESPONSE_YES) {
+        for (GList *l = paths; l; l = l->next) {
+            int id = 0;
+            if (!gtk_tree_model_get_iter(model, &iter, l->data)) continue;
+            gtk_tree_model_get(model, &iter, COL_ID, &id, -1);
+            command_remove(id);
+        }
+        command_commit(NULL);
     }
+    g_list_free_full(paths, (GDestroyNotify)gtk_tree_path_free);
 }
 
 /* Save to file */
@@ -227,7 +340,7 @@ static void on_sort_name(GtkButton *button, gpointer user_data) {
     (void)button;
     AppContext *ctx = (AppContext *)user_data;
     sort_by_name();
-    refresh_list(ctx);
+    schedule_refresh(ctx);
 }
 
 /* Sort by grade */
@@ -235,7 +348,7 @@ static void on_sort_grade(GtkButton *button, gpointer user_data) {
     (void)button;
     AppContext *ctx = (AppContext *)user_data;
     sort_by_grade_desc();
-    refresh_list(ctx);
+    schedule_refresh(ctx);
 }
 
 /* Show average dialog */
@@ -243,13 +356,154 @@ static void on_average(GtkButton *button, gpointer user_data) {
     (void)button;
     (void)user_data;
     double avg = compute_average();
-    char msg[128];
+    GString *msg = g_string_new(NULL);
     if (get_storage_count() == 0) {
-        snprintf(msg, sizeof(msg), "No students to average.");
+        g_string_append(msg, "No students to average.");
     } else {
-        snprintf(msg, sizeof(msg), "Class average: %.2f", avg);
+        g_string_append_printf(msg, "Class average: %.2f", avg);
+        for (size_t k = 0; k < gradebook_count(); ++k) {
+            double a = gradebook_average(k);
+            if (isnan(a)) g_string_append_printf(msg, "\n%s: no scores", gradebook_name(k));
+            else g_string_append_printf(msg, "\n%s: %.2f", gradebook_name(k), a);
+        }
     }
-    GtkWidget *info = gtk_message_dialog_new(NULL, GTK_DIALOG_MODAL, GTK_MESSAGE_INFO, GTK_BUTTONS_OK, "%s", msg);
+    GtkWidget *info = gtk_message_dialog_new(NULL, GTK_DIALOG_MODAL, GTK_MESSAGE_INFO, GTK_BUTTONS_OK, "%s", msg->str);
     gtk_dialog_run(GTK_DIALOG(info));
     gtk_widget_destroy(info);
+    g_string_free(msg, TRUE);
+}
+
+/* Merge a delta CSV chosen by the user and report the counts */
+static void on_merge(GtkButton *button, gpointer user_data) {
+    (void)button;
+    (void)user_data;
+
+    GtkWidget *chooser = gtk_file_chooser_dialog_new("Merge Delta CSV",
+                                                     NULL,
+                                                     GTK_FILE_CHOOSER_ACTION_OPEN,
+                                                     "_Cancel", GTK_RESPONSE_CANCEL,
+                                                     "_Merge", GTK_RESPONSE_ACCEPT,
+                                                     NULL);
+    if (gtk_dialog_run(GTK_DIALOG(chooser)) == GTK_RESPONSE_ACCEPT) {
+        char *path = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(chooser));
+        MergeStats st = {0, 0, 0};
+        StudentDelta *rows;
+        size_t n;
+        GtkWidget *info;
+        const char *why = NULL;
+        /* the whole file is one batch, undone in one step */
+        if (read_delta_file(path, &rows, &n) != 0) {
+            why = "the file is unreadable or has assessment columns\n"
+                  "(merge files take id,name,grade rows only)";
+        } else {
+            if (command_merge(rows, n) != 0) why = "merge import is not available in client mode";
+            free(rows);
+        }
+        if (!why) {
+            command_commit(&st);
+            info = gtk_message_dialog_new(NULL, GTK_DIALOG_MODAL, GTK_MESSAGE_INFO, GTK_BUTTONS_OK,
+                                          "Inserted %zu, updated %zu, deleted %zu.",
+                                          st.inserted, st.updated, st.deleted);
+        } else {
+            info = gtk_message_dialog_new(NULL, GTK_DIALOG_MODAL, GTK_MESSAGE_ERROR, GTK_BUTTONS_OK,
+                                          "Could not merge %s: %s.", path, why);
+        }
+        g_free(path);
+        gtk_dialog_run(GTK_DIALOG(info));
+        gtk_widget_destroy(info);
+    }
+    gtk_widget_destroy(chooser);
+}
+
+static void on_undo(GtkButton *button, gpointer user_data) {
+    (void)button;
+    (void)user_data;
+    command_undo();
+}
+
+static void on_redo(GtkButton *button, gpointer user_data) {
+    (void)button;
+    (void)user_data;
+    command_redo();
+}
+
+/* A score cell was edited: commit it (empty clears); the refresh shows the
+   new final */
+static void on_score_edited(GtkCellRendererText *renderer, gchar *path, gchar *text, gpointer user_data) {
+    AppContext *ctx = (AppContext *)user_data;
+    size_t k = GPOINTER_TO_SIZE(g_object_get_data(G_OBJECT(renderer), "assessment"));
+    GtkTreeIter iter;
+    if (!gtk_tree_model_get_iter_from_string(GTK_TREE_MODEL(ctx->store), &iter, path)) return;
+    int id;
+    gtk_tree_model_get(GTK_TREE_MODEL(ctx->store), &iter, COL_ID, &id, -1);
+
+    double v = NAN;
+    if (text[0]) {
+        char *end;
+        v = g_ascii_strtod(text, &end);
+        if (end == text || v < 0 || v > 100) return;
+    }
+    if (command_set_score(id, k, v) == 0) command_commit(NULL);
+}
+
+typedef struct {
+    WatchChange kind;
+    Student rec;
+    gboolean done;
+} RowChange;
+
+static void collect_change(WatchChange kind, const Student *s, void *user) {
+    RowChange c = { kind, *s, FALSE };
+    g_array_append_val((GArray *)user, c);
+}
+
+/* The data file was written by someone else: patch only the affected rows
+   so the selection and scroll position survive. */
+static gboolean on_data_file_changed(gint fd, GIOCondition cond, gpointer user_data) {
+    (void)fd;
+    (void)cond;
+    AppContext *ctx = (AppContext *)user_data;
+    GArray *changes = g_array_new(FALSE, FALSE, sizeof(RowChange));
+    watch_poll(collect_change, changes);
+    if (changes->len == 0) {
+        g_array_free(changes, TRUE);
+        return G_SOURCE_CONTINUE;
+    }
+    /* recorded batches would now undo the outside edit as well */
+    command_reset();
+    gtk_widget_set_sensitive(ctx->btn_undo, FALSE);
+    gtk_widget_set_sensitive(ctx->btn_redo, FALSE);
+
+    GHashTable *by_id = g_hash_table_new(g_direct_hash, g_direct_equal);
+    for (guint i = 0; i < changes->len; ++i) {
+        RowChange *c = &g_array_index(changes, RowChange, i);
+        g_hash_table_insert(by_id, GINT_TO_POINTER(c->rec.id), c);
+    }
+
+    GtkTreeModel *model = GTK_TREE_MODEL(ctx->store);
+    GtkTreeIter iter;
+    gboolean valid = gtk_tree_model_get_iter_first(model, &iter);
+    while (valid) {
+        int id;
+        gtk_tree_model_get(model, &iter, COL_ID, &id, -1);
+        RowChange *c = g_hash_table_lookup(by_id, GINT_TO_POINTER(id));
+        if (c && c->kind == WATCH_REMOVED) {
+            c->done = TRUE;
+            valid = gtk_list_store_remove(ctx->store, &iter);
+            continue;
+        }
+        if (c) {
+            set_row(ctx->store, &iter, &c->rec);
+            c->done = TRUE;
+        }
+        valid = gtk_tree_model_iter_next(model, &iter);
+    }
+
+    for (guint i = 0; i < changes->len; ++i) {
+        RowChange *c = &g_array_index(changes, RowChange, i);
+        if (!c->done && c->kind != WATCH_REMOVED) append_row(&c->rec, ctx->store);
+    }
+    g_hash_table_destroy(by_id);
+    g_array_free(changes, TRUE);
+    return G_SOURCE_CONTINUE;
 }
@@ -0,0 +1,197 @@
+/* src/loadgen.c
+   Load generator for grade_systemd. Each connection runs on its own
+   thread and sends requests in pipelined batches, then reports overall
+   throughput and per-request latency (time from sending a batch to
+   receiving each reply).
+
+   Usage: ./grade_loadgen [-c connections] [-n requests] [-d depth] [-s socket]
+   -n is per connection; the mix is 40% stats, 30% list-page, 20% search
+   and 10% add/remove pairs, so the roster size stays stable.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "client.h"
+#include "protocol.h"
+
+#define DEFAULT_CONNECTIONS 4
+#define DEFAULT_REQUESTS 100000
+#define DEFAULT_DEPTH 16
+#define PAGE_SIZE 20
+
+typedef struct {
+    const char *socket_path;
+    size_t requests;
+    size_t depth;
+    unsigned int seed;
+    double *latency_us;  /* one per request */
+    int *owned;          /* ids this worker added and has not removed yet */
+    size_t nowned;
+    size_t done;
+    size_t errors;
+} Worker;
+
+static double now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/* Append the i-th request of the mix to batch */
+static void queue_request(Worker *w, Client *c, ProtoBuf *batch, size_t i) {
+    size_t m;
+    switch (i % 10) {
+    case 0: case 1: case 2: case 3:
+        m = proto_begin_message(batch, OP_STATS, 0, c->next_seq++);
+        break;
+    case 4: case 5: case 6:
+        m = proto_begin_message(batch, OP_LIST_PAGE, 0, c->next_seq++);
+        pbuf_put_u32(batch, (uint32_t)(rand_r(&w->seed) % 64));
+        pbuf_put_u32(batch, PAGE_SIZE);
+        break;
+    case 7: case 8:
+        m = proto_begin_message(batch, OP_SEARCH, 0, c->next_seq++);
+        pbuf_put_u32(batch, PAGE_SIZE);
+        pbuf_put_str(batch, "an");
+        break;
+    default:
+        /* remove a student this worker added earlier, else add one */
+        if (w->nowned > 0) {
+            m = proto_begin_message(batch, OP_REMOVE, 0, c->next_seq++);
+            pbuf_put_i32(batch, w->owned[--w->nowned]);
+        } else {
+            m = proto_begin_message(batch, OP_ADD, 0, c->next_seq++);
+            pbuf_put_f64(batch, 50.0);
+            pbuf_put_str(batch, "Loadgen Student");
+        }
+        break;
+    }
+    proto_end_message(batch, m);
+}
+
+static void *worker_main(void *arg) {
+    Worker *w = arg;
+    Client *c = client_connect(w->socket_path);
+    if (!c) {
+        w->errors = w->requests;
+        return NULL;
+    }
+    ProtoBuf batch = {0};
+    while (w->done < w->requests) {
+        size_t n = w->requests - w->done;
+        if (n > w->depth) n = w->depth;
+        batch.len = 0;
+        for (size_t i = 0; i < n; ++i) queue_request(w, c, &batch, w->done + i);
+
+        double sent = now_us();
+        if (client_send(c, &batch) != 0) break;
+        for (size_t i = 0; i < n; ++i) {
+            ProtoHeader h;
+            ProtoReader r;
+            if (client_recv(c, &h, &r) != 0) {
+                w->errors += w->requests - w->done;
+                goto out;
+            }
+            w->latency_us[w->done++] = now_us() - sent;
+            if (h.status != STATUS_OK) w->errors++;
+            if (h.op == OP_ADD && h.status == STATUS_OK) w->owned[w->nowned++] = preader_i32(&r);
+        }
+    }
+out:
+    /* leave the roster as we found it */
+    while (w->nowned > 0) client_remove(c, w->owned[--w->nowned]);
+    pbuf_free(&batch);
+    client_close(c);
+    return NULL;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char *argv[]) {
+    size_t conns = DEFAULT_CONNECTIONS;
+    size_t requests = DEFAULT_REQUESTS;
+    size_t depth = DEFAULT_DEPTH;
+    const char *socket_path = PROTO_DEFAULT_SOCKET;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "c:n:d:s:")) != -1) {
+        switch (opt) {
+        case 'c': conns = strtoul(optarg, NULL, 10); break;
+        case 'n': requests = strtoul(optarg, NULL, 10); break;
+        case 'd': depth = strtoul(optarg, NULL, 10); break;
+        case 's': socket_path = optarg; break;
+        default:
+            fprintf(stderr, "Usage: %s [-c connections] [-n requests] [-d depth] [-s socket]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (conns == 0 || requests == 0 || depth == 0) {
+        fprintf(stderr, "connections, requests and depth must be positive\n");
+        return EXIT_FAILURE;
+    }
+
+    Worker *workers = calloc(conns, sizeof(Worker));
+    pthread_t *threads = calloc(conns, sizeof(pthread_t));
+    if (!workers || !threads) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return EXIT_FAILURE;
+    }
+    for (size_t i = 0; i < conns; ++i) {
+        workers[i].socket_path = socket_path;
+        workers[i].requests = requests;
+        workers[i].depth = depth;
+        workers[i].seed = (unsigned int)(i + 1);
+        workers[i].latency_us = malloc(requests * sizeof(double));
+        /* a batch only adds while nothing is owned, so depth bounds this */
+        workers[i].owned = malloc((depth + 1) * sizeof(int));
+        if (!workers[i].latency_us || !workers[i].owned) {
+            fprintf(stderr, "Memory allocation failed\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    double start = now_us();
+    for (size_t i = 0; i < conns; ++i) pthread_create(&threads[i], NULL, worker_main, &workers[i]);
+    for (size_t i = 0; i < conns; ++i) pthread_join(threads[i], NULL);
+    double elapsed = (now_us() - start) / 1e6;
+
+    size_t total = 0, errors = 0;
+    for (size_t i = 0; i < conns; ++i) {
+        total += workers[i].done;
+        errors += workers[i].errors;
+    }
+    double *all = malloc((total ? total : 1) * sizeof(double));
+    if (!all) {
+        fprintf(stderr, "Memory allocation failed\n");
+        return EXIT_FAILURE;
+    }
+    size_t pos = 0;
+    for (size_t i = 0; i < conns; ++i) {
+        memcpy(all + pos, workers[i].latency_us, workers[i].done * sizeof(double));
+        pos += workers[i].done;
+        free(workers[i].latency_us);
+        free(workers[i].owned);
+    }
+    qsort(all, total, sizeof(double), cmp_double);
+
+    printf("%zu connections, pipeline depth %zu\n", conns, depth);
+    printf("%zu requests in %.2f s: %.0f req/s, %zu errors\n",
+           total, elapsed, elapsed > 0 ? total / elapsed : 0.0, errors);
+    if (total > 0) {
+        printf("latency us: p50 %.1f  p90 %.1f  p99 %.1f  max %.1f\n",
+               all[total / 2], all[total * 9 / 10], all[total * 99 / 100], all[total - 1]);
+    }
+    free(all);
+    free(workers);
+    free(threads);
+    return errors ? EXIT_FAILURE : 0;
+}
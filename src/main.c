@@ -1,9 +1,13 @@
 
 
 #include <stdio.h>
+#include <stdlib.h>
 #include "storage.h"
 #include "csv.h"
 #include "ui.h"
+#include "threadpool.h"
+#include "command.h"
+#include "watch.h"
 
 #define DATA_FILE "data/students.csv"
 
@@ -11,9 +15,17 @@ int main(void) {
      /* Initialize storage (optional here, storage starts empty) */
     init_storage();
 
-    /* Load persisted students (if file exists) */
+    /* Act as a thin client of grade_systemd when GRADE_SERVER names its socket */
+    const char *server = getenv("GRADE_SERVER");
+    if (server && storage_connect(server) != 0)
+        fprintf(stderr, "Falling back to %s\n", DATA_FILE);
+
+    /* Load persisted students (if file exists; the server loads its own) */
     load_from_file(DATA_FILE);
 
+    /* Pick up edits other tools make to the data file while we run */
+    watch_start(DATA_FILE);
+
     /* Run the interactive menu */
     menu();
 
@@ -21,7 +33,10 @@ int main(void) {
     save_to_file(DATA_FILE);
 
     /* Cleanup */
+    watch_stop();
+    command_reset();
     free_storage();
+    pool_shutdown();
     return 0;
 }
 
@@ -3,8 +3,13 @@
 */
 
 #include <gtk/gtk.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include "storage.h"
 #include "csv.h"
+#include "threadpool.h"
+#include "command.h"
+#include "watch.h"
 
 /* Prototype for GUI builder returning a window widget */
 GtkWidget *build_main_window(void);
@@ -13,8 +18,15 @@ int main(int argc, char *argv[]) {
     /* initialize storage */
     init_storage();
 
-    /* load data */
+    /* connect to grade_systemd if GRADE_SERVER names its socket */
+    const char *server = getenv("GRADE_SERVER");
+    if (server && storage_connect(server) != 0)
+        fprintf(stderr, "Falling back to data/students.csv\n");
+
+    /* load data (the server loads its own) */
     load_from_file("data/students.csv");
+    /* reload rows other tools change in the file (see build_main_window) */
+    watch_start("data/students.csv");
 
     /* init GTK */
     gtk_init(&argc, &argv);
@@ -27,6 +39,9 @@ int main(int argc, char *argv[]) {
 
     /* save and cleanup */
     save_to_file("data/students.csv");
+    watch_stop();
+    command_reset();
     free_storage();
+    pool_shutdown();
     return 0;
 }
@@ -0,0 +1,129 @@
+/* src/protocol.c — encoding helpers for the grade_systemd wire protocol */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "protocol.h"
+
+void pbuf_free(ProtoBuf *b) {
+    free(b->data);
+    b->data = NULL;
+    b->len = 0;
+    b->cap = 0;
+}
+
+void pbuf_reserve(ProtoBuf *b, size_t extra) {
+    if (b->len + extra <= b->cap) return;
+    size_t newcap = b->cap ? b->cap : 256;
+    while (newcap < b->len + extra) newcap *= 2;
+    unsigned char *tmp = realloc(b->data, newcap);
+    if (!tmp) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    b->data = tmp;
+    b->cap = newcap;
+}
+
+void pbuf_consume(ProtoBuf *b, size_t n) {
+    if (n >= b->len) {
+        b->len = 0;
+        return;
+    }
+    memmove(b->data, b->data + n, b->len - n);
+    b->len -= n;
+}
+
+static void put_raw(ProtoBuf *b, const void *p, size_t n) {
+    pbuf_reserve(b, n);
+    memcpy(b->data + b->len, p, n);
+    b->len += n;
+}
+
+void pbuf_put_u8(ProtoBuf *b, uint8_t v) { put_raw(b, &v, sizeof(v)); }
+void pbuf_put_u16(ProtoBuf *b, uint16_t v) { put_raw(b, &v, sizeof(v)); }
+void pbuf_put_u32(ProtoBuf *b, uint32_t v) { put_raw(b, &v, sizeof(v)); }
+void pbuf_put_i32(ProtoBuf *b, int32_t v) { put_raw(b, &v, sizeof(v)); }
+void pbuf_put_f64(ProtoBuf *b, double v) { put_raw(b, &v, sizeof(v)); }
+
+void pbuf_put_str(ProtoBuf *b, const char *s) {
+    size_t n = strlen(s);
+    if (n > UINT16_MAX) n = UINT16_MAX;
+    pbuf_put_u16(b, (uint16_t)n);
+    put_raw(b, s, n);
+}
+
+void pbuf_put_student(ProtoBuf *b, const Student *s) {
+    pbuf_put_i32(b, s->id);
+    pbuf_put_f64(b, s->grade);
+    pbuf_put_str(b, s->name);
+}
+
+size_t proto_begin_message(ProtoBuf *b, uint8_t op, uint8_t status, uint32_t seq) {
+    size_t off = b->len;
+    pbuf_put_u32(b, 0);
+    pbuf_put_u32(b, seq);
+    pbuf_put_u8(b, op);
+    pbuf_put_u8(b, status);
+    pbuf_put_u16(b, 0);
+    return off;
+}
+
+void proto_end_message(ProtoBuf *b, size_t header_off) {
+    uint32_t len = (uint32_t)(b->len - header_off - PROTO_HEADER_SIZE);
+    memcpy(b->data + header_off, &len, sizeof(len));
+}
+
+void proto_read_header(const unsigned char *p, ProtoHeader *h) {
+    memcpy(&h->len, p, 4);
+    memcpy(&h->seq, p + 4, 4);
+    h->op = p[8];
+    h->status = p[9];
+    memcpy(&h->reserved, p + 10, 2);
+}
+
+void preader_init(ProtoReader *r, const void *p, size_t n) {
+    r->p = p;
+    r->left = n;
+    r->err = 0;
+}
+
+static int get_raw(ProtoReader *r, void *out, size_t n) {
+    if (r->err || r->left < n) {
+        r->err = 1;
+        memset(out, 0, n);
+        return 0;
+    }
+    memcpy(out, r->p, n);
+    r->p += n;
+    r->left -= n;
+    return 1;
+}
+
+uint8_t preader_u8(ProtoReader *r) { uint8_t v; get_raw(r, &v, sizeof(v)); return v; }
+uint16_t preader_u16(ProtoReader *r) { uint16_t v; get_raw(r, &v, sizeof(v)); return v; }
+uint32_t preader_u32(ProtoReader *r) { uint32_t v; get_raw(r, &v, sizeof(v)); return v; }
+int32_t preader_i32(ProtoReader *r) { int32_t v; get_raw(r, &v, sizeof(v)); return v; }
+double preader_f64(ProtoReader *r) { double v; get_raw(r, &v, sizeof(v)); return v; }
+
+void preader_str(ProtoReader *r, char *out, size_t cap) {
+    size_t n = preader_u16(r);
+    out[0] = '\0';
+    if (r->err) return;
+    if (r->left < n) {
+        r->err = 1;
+        return;
+    }
+    size_t keep = n < cap - 1 ? n : cap - 1;
+    memcpy(out, r->p, keep);
+    out[keep] = '\0';
+    r->p += n;
+    r->left -= n;
+}
+
+void preader_student(ProtoReader *r, Student *s) {
+    s->id = preader_i32(r);
+    s->grade = preader_f64(r);
+    preader_str(r, s->name, NAME_LENGTH);
+}
@@ -0,0 +1,109 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+/* Wire protocol between grade_systemd and its clients.
+
+   Every message is a fixed header followed by `len` payload bytes. The
+   daemon answers requests in the order it receives them and echoes `seq`,
+   so a client may pipeline many requests before reading replies. Integers
+   and doubles travel in host byte order: the socket is local only. */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "storage.h"
+
+#define PROTO_DEFAULT_SOCKET "data/grade_systemd.sock"
+#define PROTO_HEADER_SIZE 12
+#define PROTO_MAX_PAYLOAD (1u << 20)
+/* Largest page a LIST_PAGE or SEARCH reply will carry */
+#define PROTO_MAX_PAGE 1024
+
+typedef struct {
+    uint32_t len;   /* payload bytes after the header */
+    uint32_t seq;   /* chosen by the client, echoed in the reply */
+    uint8_t op;
+    uint8_t status; /* replies only */
+    uint16_t reserved;
+} ProtoHeader;
+
+/* Requests and their payloads (reply payloads after the arrow):
+   ADD        f64 grade, str name        -> i32 id
+   REMOVE     i32 id                     -> (status NOT_FOUND if absent)
+   LIST_PAGE  u32 offset, u32 limit      -> u32 generation, u32 total,
+                                            u32 n, n records
+   STATS      -                          -> u32 count, f64 average
+   SEARCH     u32 limit, str needle      -> u32 n, n records
+   SORT       u8 order                   -> -
+   SAVE       -                          -> -
+   str is u16 length + bytes; a record is i32 id, f64 grade, str name.
+   LIST_PAGE pages through the current sort order; the generation changes
+   whenever the roster or its order does, so a client can tell whether
+   pages fetched one after another belong to the same roster (limit 0
+   asks for just the generation and total). SEARCH matches name
+   substrings case-insensitively. */
+enum {
+    OP_ADD = 1,
+    OP_REMOVE,
+    OP_LIST_PAGE,
+    OP_STATS,
+    OP_SEARCH,
+    OP_SORT,
+    OP_SAVE
+};
+
+enum {
+    SORT_ORDER_NAME = 1,
+    SORT_ORDER_GRADE_DESC
+};
+
+enum {
+    STATUS_OK = 0,
+    STATUS_NOT_FOUND,
+    STATUS_BAD_REQUEST,
+    STATUS_ERROR
+};
+
+/* Growable output buffer */
+typedef struct {
+    unsigned char *data;
+    size_t len;
+    size_t cap;
+} ProtoBuf;
+
+/* Bounds-checked reader; `err` is set once any read runs past the end */
+typedef struct {
+    const unsigned char *p;
+    size_t left;
+    int err;
+} ProtoReader;
+
+void pbuf_free(ProtoBuf *b);
+void pbuf_reserve(ProtoBuf *b, size_t extra);
+/* drop the first n bytes */
+void pbuf_consume(ProtoBuf *b, size_t n);
+void pbuf_put_u8(ProtoBuf *b, uint8_t v);
+void pbuf_put_u16(ProtoBuf *b, uint16_t v);
+void pbuf_put_u32(ProtoBuf *b, uint32_t v);
+void pbuf_put_i32(ProtoBuf *b, int32_t v);
+void pbuf_put_f64(ProtoBuf *b, double v);
+void pbuf_put_str(ProtoBuf *b, const char *s);
+void pbuf_put_student(ProtoBuf *b, const Student *s);
+
+/* Append a header for a payload that will follow; returns its offset so
+   proto_end_message can fill in the length once the payload is written. */
+size_t proto_begin_message(ProtoBuf *b, uint8_t op, uint8_t status, uint32_t seq);
+void proto_end_message(ProtoBuf *b, size_t header_off);
+/* Decode a header from the first PROTO_HEADER_SIZE bytes of p */
+void proto_read_header(const unsigned char *p, ProtoHeader *h);
+
+void preader_init(ProtoReader *r, const void *p, size_t n);
+uint8_t preader_u8(ProtoReader *r);
+uint16_t preader_u16(ProtoReader *r);
+uint32_t preader_u32(ProtoReader *r);
+int32_t preader_i32(ProtoReader *r);
+double preader_f64(ProtoReader *r);
+/* copies at most cap - 1 bytes and always terminates out */
+void preader_str(ProtoReader *r, char *out, size_t cap);
+void preader_student(ProtoReader *r, Student *s);
+
+#endif /* PROTOCOL_H */
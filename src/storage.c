@@ -1,85 +1,436 @@
+#define _GNU_SOURCE /* mremap */
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
+#include <stdint.h>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
 #include "storage.h"
+#include "bptree.h"
+#include "threadpool.h"
+#include "client.h"
+#include "gradebook.h"
+
+/* Sorts and aggregates hand off to the thread pool above this size */
+#define PARALLEL_THRESHOLD 32768
 
+/* Capacity policy for the flat array: double when full; once it falls
+   under a quarter full, halve until it is not. The gap between the two
+   thresholds means alternating adds and removes never reallocate on
+   every call. */
+#define MIN_CAPACITY 8
+#define SHRINK_DIVISOR 4
+
+/* With GRADE_HUGEPAGES=1 arrays of at least one huge page are mapped
+   with transparent huge pages (Linux), cutting TLB misses on full scans
+   of large rosters. */
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+#define HAVE_HUGE_PAGES 1
+#define HUGE_PAGE_SIZE ((size_t)2 << 20)
+#endif
+
+static StorageBackend backend = STORAGE_BACKEND_ARRAY;
+static int quiet = 0;
+
+/* flat array backend */
 static Student *students = NULL;
 static size_t count = 0;
 static size_t capacity = 0;
 static int next_id = 1;
+/* the array came from mmap (length students_bytes) rather than malloc */
+static int students_mapped = 0;
+static size_t students_bytes = 0;
+
+/* B+tree backend. `view` is a flat snapshot handed out by
+   get_storage_array() and used as the display order after a sort;
+   any change to the tree drops it. */
+static BPTree *tree = NULL;
+static Student *view = NULL;
+static size_t view_count = 0;
+static size_t view_cap = 0;
+static int view_valid = 0;
+static int view_sorted = 0;
+
+/* Remote backend: a thin client of grade_systemd. `view` caches the
+   server's roster as of `view_gen`; it is fetched again only when the
+   server reports a different generation. */
+static Client *remote = NULL;
+static uint32_t view_gen = 0;
+/* listings restarted because the roster changed between pages */
+#define REMOTE_RETRIES 8
+
+static void alloc_failed(void) {
+    fprintf(stderr, "Memory allocation failed\n");
+    exit(EXIT_FAILURE);
+}
+
+#ifdef HAVE_HUGE_PAGES
+static int huge_pages_enabled(void) {
+    static int enabled = -1;
+    if (enabled < 0) {
+        const char *env = getenv("GRADE_HUGEPAGES");
+        enabled = env && atoi(env) > 0;
+    }
+    return enabled;
+}
 
+/* Grow, shrink or create the huge-page mapping; 0 if mmap refused */
+static int map_students(size_t bytes) {
+    size_t len = (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    void *p;
+    if (students_mapped) {
+        if (len == students_bytes) return 1;
+        p = mremap(students, students_bytes, len, MREMAP_MAYMOVE);
+        if (p == MAP_FAILED) return 0;
+    } else {
+        p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) return 0;
+        madvise(p, len, MADV_HUGEPAGE);
+        if (count) memcpy(p, students, count * sizeof(Student));
+        free(students);
+    }
+    students = p;
+    students_mapped = 1;
+    students_bytes = len;
+    capacity = len / sizeof(Student);
+    return 1;
+}
+#endif
+
+static void release_students(void) {
+#ifdef HAVE_HUGE_PAGES
+    if (students_mapped) munmap(students, students_bytes);
+    else free(students);
+#else
+    free(students);
+#endif
+    students = NULL;
+    students_mapped = 0;
+    students_bytes = 0;
+    capacity = 0;
+}
+
+/* Move the array to a block of at least newcap records (and count).
+   may_map allows a huge-page mapping, which rounds up to 2 MiB. */
+static void resize_students(size_t newcap, int may_map) {
+    if (newcap < count) newcap = count;
+    if (newcap == 0) {
+        release_students();
+        return;
+    }
+    size_t bytes = newcap * sizeof(Student);
+#ifdef HAVE_HUGE_PAGES
+    if (may_map && huge_pages_enabled() && bytes >= HUGE_PAGE_SIZE && map_students(bytes)) return;
+#else
+    (void)may_map;
+#endif
+    Student *p;
+    if (students_mapped) {
+        p = malloc(bytes);
+        if (!p) alloc_failed();
+        memcpy(p, students, count * sizeof(Student));
+        release_students();
+    } else {
+        p = realloc(students, bytes);
+        if (!p) alloc_failed();
+    }
+    students = p;
+    capacity = newcap;
+}
+
+/* Room for one more record */
 static void ensure_capacity(void) {
-    if (capacity==0) {
-        capacity = 8;
-        students = malloc(capacity * sizeof(Student));
-         if (!students) {
-            fprintf(stderr, "Memory allocation failed\n");
-            exit(EXIT_FAILURE);
-        }
-    } else if (count >= capacity) {
-        size_t newcap = capacity * 2;
-        Student *tmp = realloc(students, newcap * sizeof(Student));
-        if (!tmp) {
-            fprintf(stderr, "Memory reallocation failed\n");
-            exit(EXIT_FAILURE);
-        }
-        students = tmp;
-        capacity = newcap;
+    if (count < capacity) return;
+    resize_students(capacity ? capacity * 2 : MIN_CAPACITY, 1);
+}
+
+/* After removals: give memory back once the array is under a quarter full */
+static void maybe_shrink(void) {
+    if (capacity <= MIN_CAPACITY || count >= capacity / SHRINK_DIVISOR) return;
+    size_t target = capacity / 2;
+    while (target > MIN_CAPACITY && count < target / SHRINK_DIVISOR) target /= 2;
+    resize_students(target < MIN_CAPACITY ? MIN_CAPACITY : target, 1);
+}
+
+static void invalidate_view(void) {
+    view_valid = 0;
+    view_sorted = 0;
+}
+
+static int copy_to_view(const Student *s, void *user) {
+    size_t *pos = user;
+    view[(*pos)++] = *s;
+    return 0;
+}
+
+static void resize_view(size_t n) {
+    Student *tmp = realloc(view, (n ? n : 1) * sizeof(Student));
+    if (!tmp) alloc_failed();
+    view = tmp;
+    view_cap = n;
+}
+
+static void reserve_view(size_t n) {
+    if (n <= view_cap) return;
+    resize_view(n > view_cap * 2 ? n : view_cap * 2);
+}
+
+/* Materialize the tree into `view` (id order) unless already current */
+static void build_view(void) {
+    if (view_valid) return;
+    size_t n = bpt_size(tree);
+    /* same hysteresis as the array: drop a snapshot buffer far too big */
+    if (view_cap > MIN_CAPACITY && n < view_cap / SHRINK_DIVISOR) resize_view(n);
+    reserve_view(n);
+    size_t pos = 0;
+    bpt_foreach(tree, copy_to_view, &pos);
+    view_count = pos;
+    view_valid = 1;
+    view_sorted = 0;
+}
+
+static void remote_failed(void) {
+    fprintf(stderr, "Lost connection to grade_systemd\n");
+    exit(EXIT_FAILURE);
+}
+
+/* Bring `view` up to date with the server's roster, in its current order.
+   A cached view costs one empty LIST_PAGE to confirm. All pages must
+   carry the same generation; a listing that straddles a change by
+   another client is started again (up to REMOTE_RETRIES times, after
+   which the last one is kept). */
+static void remote_refresh(void) {
+    uint32_t gen = 0;
+    if (view_valid) {
+        int rc = client_list_page(remote, 0, 0, NULL, NULL, NULL, &gen);
+        if (rc < 0) remote_failed();
+        if (rc == STATUS_OK && gen == view_gen) return;
+    }
+    size_t offset = 0;
+    for (int attempt = 0; attempt <= REMOTE_RETRIES; ++attempt) {
+        size_t total = 0;
+        int torn = 0;
+        offset = 0;
+        do {
+            size_t n = 0;
+            uint32_t page_gen = 0;
+            reserve_view(offset + PROTO_MAX_PAGE);
+            int rc = client_list_page(remote, offset, PROTO_MAX_PAGE, view + offset, &n, &total, &page_gen);
+            if (rc < 0) remote_failed();
+            if (rc != STATUS_OK) break;
+            if (offset == 0) gen = page_gen;
+            else if (page_gen != gen && attempt < REMOTE_RETRIES) {
+                torn = 1;
+                break;
+            }
+            if (n == 0) break;
+            offset += n;
+        } while (offset < total);
+        if (!torn) break;
+    }
+    view_count = offset;
+    view_gen = gen;
+    view_valid = 1;
+    view_sorted = 1;
+}
+
+static void tree_insert_all(const Student *arr, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        if (!bpt_insert(tree, &arr[i]))
+            fprintf(stderr, "Warning: duplicate id %d ignored\n", arr[i].id);
     }
 }
 
 void init_storage(void) {
     /* start empty; ensure variables are sane */
     /* (students NULL, count 0, capacity 0, next_id 1) */
-    /* This function exists for explicit initialization if needed. */
-    /* Nothing required here for now. */
+    const char *env = getenv("GRADE_STORAGE");
+    if (env && strcasecmp(env, "bptree") == 0) storage_set_backend(STORAGE_BACKEND_BPTREE);
+    else if (env && strcasecmp(env, "array") == 0) storage_set_backend(STORAGE_BACKEND_ARRAY);
 }
 
 void free_storage() {
-    free(students);
-    students = NULL;
+    client_close(remote);
+    remote = NULL;
+    release_students();
     count = 0;
-    capacity = 0;
     next_id = 1;
+    bpt_destroy(tree);
+    tree = NULL;
+    free(view);
+    view = NULL;
+    view_count = 0;
+    view_cap = 0;
+    invalidate_view();
+    gradebook_clear();
+    backend = STORAGE_BACKEND_ARRAY;
+}
+
+/* Hand `view` over to the caller as a plain array */
+static Student *detach_view(size_t *n, size_t *cap) {
+    Student *arr = view;
+    *n = view_count;
+    *cap = view_cap;
+    view = NULL;
+    view_count = 0;
+    view_cap = 0;
+    invalidate_view();
+    return arr;
+}
+
+void storage_set_backend(StorageBackend b) {
+    if (b == backend) return;
+    if (b == STORAGE_BACKEND_REMOTE) {
+        fprintf(stderr, "Use storage_connect() to select the remote backend\n");
+        return;
+    }
+
+    /* take the records out of the current container, keeping the
+       current display order (id order or last sort) */
+    Student *arr;
+    size_t n, cap;
+    if (backend == STORAGE_BACKEND_ARRAY) {
+        /* a plain malloc block is what the other containers expect */
+        if (students_mapped) {
+            arr = malloc((count ? count : 1) * sizeof(Student));
+            if (!arr) alloc_failed();
+            if (count) memcpy(arr, students, count * sizeof(Student));
+            cap = count;
+            n = count;
+            release_students();
+        } else {
+            arr = students;
+            n = count;
+            cap = capacity;
+            students = NULL;
+            capacity = 0;
+        }
+        count = 0;
+    } else if (backend == STORAGE_BACKEND_BPTREE) {
+        build_view();
+        arr = detach_view(&n, &cap);
+        bpt_destroy(tree);
+        tree = NULL;
+    } else {
+        remote_refresh();
+        arr = detach_view(&n, &cap);
+        client_close(remote);
+        remote = NULL;
+    }
+
+    backend = b;
+    if (b == STORAGE_BACKEND_BPTREE) {
+        tree = bpt_create();
+        tree_insert_all(arr, n);
+        free(arr);
+    } else {
+        students = arr;
+        count = n;
+        capacity = arr ? cap : 0;
+    }
+}
+
+int storage_connect(const char *socket_path) {
+    Client *c = client_connect(socket_path);
+    if (!c) return -1;
+    free_storage();
+    remote = c;
+    backend = STORAGE_BACKEND_REMOTE;
+    return 0;
+}
+
+StorageBackend storage_get_backend(void) { return backend; }
+
+const char *storage_backend_name(void) {
+    switch (backend) {
+    case STORAGE_BACKEND_BPTREE: return "bptree";
+    case STORAGE_BACKEND_REMOTE: return "remote";
+    default: return "array";
+    }
 }
 
-void add_student(const char *name, double grade) {
-    if (!name) return;
-    ensure_capacity();
-    students[count].id = next_id++;
-    strncpy(students[count].name, name, NAME_LENGTH - 1);
-    students[count].name[NAME_LENGTH- 1] = '\0';
-    students[count].grade = grade;
-    count++;
-    printf("Added student (id=%d)\n", next_id - 1);
+void storage_set_quiet(int q) { quiet = q; }
 
+int add_student(const char *name, double grade) {
+    if (!name) return 0;
+    if (backend == STORAGE_BACKEND_REMOTE) {
+        int id = 0;
+        int rc = client_add(remote, name, grade, &id);
+        if (rc < 0) remote_failed();
+        if (rc != STATUS_OK) {
+            fprintf(stderr, "Server rejected the new student\n");
+            return 0;
+        }
+        if (!quiet) printf("Added student (id=%d)\n", id);
+        return id;
+    }
+    Student s;
+    s.id = next_id++;
+    strncpy(s.name, name, NAME_LENGTH - 1);
+    s.name[NAME_LENGTH- 1] = '\0';
+    s.grade = grade;
+    if (backend == STORAGE_BACKEND_BPTREE) {
+        bpt_insert(tree, &s);
+        invalidate_view();
+    } else {
+        ensure_capacity();
+        students[count++] = s;
+    }
+    if (!quiet) printf("Added student (id=%d)\n", s.id);
+    return s.id;
 }
 
 void remove_student(int id) {
+    if (backend == STORAGE_BACKEND_REMOTE) {
+        int rc = client_remove(remote, id);
+        if (rc < 0) remote_failed();
+        if (!quiet) {
+            if (rc == STATUS_OK) printf("Removed student id %d\n", id);
+            else printf("No student with id %d\n", id);
+        }
+        return;
+    }
+    if (backend == STORAGE_BACKEND_BPTREE) {
+        if (!bpt_remove(tree, id)) {
+            if (!quiet) printf("No student with id %d\n", id);
+            return;
+        }
+        invalidate_view();
+        gradebook_remove(id);
+        if (!quiet) printf("Removed student id %d\n", id);
+        return;
+    }
     size_t idx = SIZE_MAX;
     for (size_t i = 0; i < count; ++i) {
         if (students[i].id == id) { idx = i; break; }
     }
     if (idx == SIZE_MAX) {
-        printf("No student with id %d\n", id);
+        if (!quiet) printf("No student with id %d\n", id);
         return;
     }
-    for (size_t i = idx; i + 1 < count; ++i) students[i] = students[i+1];
+    memmove(&students[idx], &students[idx + 1], (count - idx - 1) * sizeof(Student));
     count--;
-    printf("Removed student id %d\n", id);
+    maybe_shrink();
+    gradebook_remove(id);
+    if (!quiet) printf("Removed student id %d\n", id);
+}
+
+static int print_row(const Student *s, void *user) {
+    (void)user;
+    printf("%-5d %-30s %-6.2f\n", s->id, s->name, s->grade);
+    return 0;
 }
 
 void list_students(void) {
-    if (count == 0) {
+    if (get_storage_count() == 0) {
         puts("No students found.");
         return;
     }
     printf("%-5s %-30s %-6s\n", "ID", "Name", "Grade");
     puts("-------------------------------------------------");
-    for (size_t i = 0; i < count; ++i) {
-        printf("%-5d %-30s %-6.2f\n", students[i].id, students[i].name, students[i].grade);
-    }
+    storage_foreach(print_row, NULL);
 }
 
 static int cmp_name(const void *a, const void *b) {
@@ -92,9 +443,34 @@ static int cmp_name(const void *a, const void *b) {
 #endif
 }
 
+static void sort_array(Student *arr, size_t n, int (*cmp)(const void *, const void *)) {
+    if (n >= PARALLEL_THRESHOLD) parallel_sort(arr, n, sizeof(Student), cmp);
+    else if (n > 1) qsort(arr, n, sizeof(Student), cmp);
+}
+
+static int cmp_grade_desc(const void *a, const void *b);
+
+/* Sort the container in place; the B+tree sorts its snapshot instead,
+   which stays the display order until the next change. The server sorts
+   its own roster for every client. */
+static void sort_current(int (*cmp)(const void *, const void *)) {
+    if (backend == STORAGE_BACKEND_REMOTE) {
+        int order = cmp == cmp_name ? SORT_ORDER_NAME : SORT_ORDER_GRADE_DESC;
+        if (client_sort(remote, order) < 0) remote_failed();
+        return;
+    }
+    if (backend == STORAGE_BACKEND_BPTREE) {
+        build_view();
+        sort_array(view, view_count, cmp);
+        view_sorted = 1;
+        return;
+    }
+    sort_array(students, count, cmp);
+}
+
 void sort_by_name(void) {
-    if (count > 1) qsort(students, count, sizeof(Student), cmp_name);
-    puts("Sorted by name.");
+    sort_current(cmp_name);
+    if (!quiet) puts("Sorted by name.");
 }
 
 static int cmp_grade_desc(const void *a, const void *b) {
@@ -106,29 +482,447 @@ static int cmp_grade_desc(const void *a, const void *b) {
 }
 
 void sort_by_grade_desc(void) {
-    if (count > 1) qsort(students, count, sizeof(Student), cmp_grade_desc);
-    puts("Sorted by grade (desc).");
+    sort_current(cmp_grade_desc);
+    if (!quiet) puts("Sorted by grade (desc).");
+}
+
+static int add_grade(const Student *s, void *user) {
+    *(double *)user += s->grade;
+    return 0;
+}
+
+typedef struct {
+    const Student *arr;
+    size_t n;
+    double sum;
+} GradeChunk;
+
+static void sum_chunk(void *arg) {
+    GradeChunk *c = arg;
+    double sum = 0.0;
+    for (size_t i = 0; i < c->n; ++i) sum += c->arr[i].grade;
+    c->sum = sum;
+}
+
+/* Parallel reduction: one chunk per task, partials added in chunk order
+   so the result does not depend on scheduling. */
+static double parallel_grade_sum(const Student *arr, size_t n) {
+    size_t nchunks = pool_thread_count() * 4;
+    if (nchunks > n / 1024) nchunks = n / 1024;
+    if (nchunks < 2) {
+        GradeChunk c = { arr, n, 0.0 };
+        sum_chunk(&c);
+        return c.sum;
+    }
+    GradeChunk *chunks = malloc(nchunks * sizeof(GradeChunk));
+    if (!chunks) {
+        GradeChunk c = { arr, n, 0.0 };
+        sum_chunk(&c);
+        return c.sum;
+    }
+    TaskGroup g;
+    pool_group_init(&g);
+    size_t per = n / nchunks, start = 0;
+    for (size_t i = 0; i < nchunks; ++i) {
+        chunks[i].arr = arr + start;
+        chunks[i].n = (i + 1 == nchunks) ? n - start : per;
+        start += chunks[i].n;
+        pool_spawn(&g, sum_chunk, &chunks[i]);
+    }
+    pool_wait(&g);
+    double sum = 0.0;
+    for (size_t i = 0; i < nchunks; ++i) sum += chunks[i].sum;
+    free(chunks);
+    return sum;
 }
 
 double compute_average(void) {
-    if (count == 0) return 0.0;
+    if (backend == STORAGE_BACKEND_REMOTE) {
+        double avg = 0.0;
+        if (client_stats(remote, NULL, &avg) < 0) remote_failed();
+        return avg;
+    }
+    size_t n = get_storage_count();
+    if (n == 0) return 0.0;
     double sum = 0.0;
-    for (size_t i = 0; i < count; ++i) sum += students[i].grade;
-    return sum / (double)count;
+    if (n >= PARALLEL_THRESHOLD && backend == STORAGE_BACKEND_ARRAY)
+        sum = parallel_grade_sum(students, n);
+    else if (n >= PARALLEL_THRESHOLD && view_valid)
+        sum = parallel_grade_sum(view, view_count);
+    else
+        storage_foreach(add_grade, &sum);
+    return sum / (double)n;
+}
+
+size_t storage_foreach(student_visit_fn fn, void *user) {
+    if (!fn) return 0;
+    const Student *arr = students;
+    size_t n = count;
+    if (backend == STORAGE_BACKEND_REMOTE) remote_refresh();
+    if (backend != STORAGE_BACKEND_ARRAY) {
+        if (!view_sorted) return bpt_foreach(tree, fn, user);
+        arr = view;
+        n = view_count;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        if (fn(&arr[i], user)) return i + 1;
+    }
+    return n;
+}
+
+size_t storage_range_by_id(int lo, int hi, student_visit_fn fn, void *user) {
+    if (!fn || lo > hi) return 0;
+    if (backend == STORAGE_BACKEND_BPTREE) return bpt_range(tree, lo, hi, fn, user);
+    /* the array is unordered by id, so this is a filtered scan */
+    const Student *arr = get_storage_array();
+    size_t n = backend == STORAGE_BACKEND_REMOTE ? view_count : count;
+    size_t visited = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (arr[i].id < lo || arr[i].id > hi) continue;
+        visited++;
+        if (fn(&arr[i], user)) break;
+    }
+    return visited;
+}
+
+const Student *find_student(int id) {
+    if (backend == STORAGE_BACKEND_BPTREE) return bpt_find(tree, id);
+    const Student *arr = get_storage_array();
+    size_t n = backend == STORAGE_BACKEND_REMOTE ? view_count : count;
+    for (size_t i = 0; i < n; ++i) {
+        if (arr[i].id == id) return &arr[i];
+    }
+    return NULL;
+}
+
+size_t storage_page(size_t offset, size_t limit, student_visit_fn fn, void *user) {
+    if (!fn || limit == 0) return 0;
+    if (backend == STORAGE_BACKEND_REMOTE) {
+        if (limit > PROTO_MAX_PAGE) limit = PROTO_MAX_PAGE;
+        Student *page = malloc(limit * sizeof(Student));
+        if (!page) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+        size_t n = 0, total = 0;
+        int rc = client_list_page(remote, offset, limit, page, &n, &total, NULL);
+        if (rc < 0) remote_failed();
+        if (rc != STATUS_OK) n = 0;
+        size_t visited = 0;
+        while (visited < n) {
+            if (fn(&page[visited++], user)) break;
+        }
+        free(page);
+        return visited;
+    }
+    const Student *arr = students;
+    size_t n = count;
+    if (backend == STORAGE_BACKEND_BPTREE) {
+        build_view();
+        arr = view;
+        n = view_count;
+    }
+    if (offset >= n) return 0;
+    if (limit > n - offset) limit = n - offset;
+    for (size_t i = 0; i < limit; ++i) {
+        if (fn(&arr[offset + i], user)) return i + 1;
+    }
+    return limit;
+}
+
+long storage_position(int id) {
+    const Student *arr = get_storage_array();
+    size_t n = backend == STORAGE_BACKEND_ARRAY ? count : view_count;
+    if (backend == STORAGE_BACKEND_BPTREE && !view_sorted) {
+        /* snapshot in id order */
+        size_t lo = 0, hi = n;
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (arr[mid].id < id) lo = mid + 1;
+            else hi = mid;
+        }
+        return lo < n && arr[lo].id == id ? (long)lo : -1;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        if (arr[i].id == id) return (long)i;
+    }
+    return -1;
+}
+
+/* ---- merge import ----
+   The flat array hash-joins: the delta is the build side (id -> row) and
+   one pass over the roster probes it, updating matches and compacting out
+   tombstoned rows as it goes. Unmatched rows are appended afterwards.
+   The B+tree already has an id index, so each row is a direct lookup. */
+
+#define NO_ROW SIZE_MAX
+
+typedef struct {
+    size_t *slots; /* row index per slot, NO_ROW when empty */
+    size_t mask;
+    const StudentDelta *rows;
+} DeltaIndex;
+
+static size_t hash_id(int id) {
+    return (size_t)((unsigned int)id * 2654435761u);
+}
+
+static size_t delta_slot(const DeltaIndex *ix, int id) {
+    size_t h = hash_id(id) & ix->mask;
+    while (ix->slots[h] != NO_ROW && ix->rows[ix->slots[h]].rec.id != id) h = (h + 1) & ix->mask;
+    return h;
+}
+
+static void delta_index_build(DeltaIndex *ix, const StudentDelta *rows, size_t n) {
+    size_t cap = 16;
+    while (cap < n * 2) cap *= 2;
+    ix->slots = malloc(cap * sizeof(size_t));
+    if (!ix->slots) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < cap; ++i) ix->slots[i] = NO_ROW;
+    ix->mask = cap - 1;
+    ix->rows = rows;
+    for (size_t i = 0; i < n; ++i) {
+        if (rows[i].rec.id <= 0) continue;
+        ix->slots[delta_slot(ix, rows[i].rec.id)] = i; /* later rows win */
+    }
+}
+
+static size_t delta_lookup(const DeltaIndex *ix, int id) {
+    return ix->slots[delta_slot(ix, id)];
+}
+
+static void apply_row(Student *dst, const Student *src) {
+    memcpy(dst->name, src->name, NAME_LENGTH);
+    dst->name[NAME_LENGTH - 1] = '\0';
+    dst->grade = src->grade;
+}
+
+typedef struct {
+    size_t pos;
+    size_t row;
+} Placement;
+
+static int cmp_placement(const void *a, const void *b) {
+    size_t x = ((const Placement *)a)->pos, y = ((const Placement *)b)->pos;
+    return (x > y) - (x < y);
+}
+
+static void merge_array(const StudentDelta *rows, const size_t *pos, size_t n, MergeStats *st) {
+    DeltaIndex ix;
+    delta_index_build(&ix, rows, n);
+    unsigned char *matched = calloc(n, 1);
+    if (!matched) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t w = 0;
+    for (size_t r = 0; r < count; ++r) {
+        size_t j = delta_lookup(&ix, students[r].id);
+        if (j != NO_ROW) {
+            matched[j] = 1;
+            if (rows[j].tombstone) {
+                gradebook_remove(students[r].id);
+                st->deleted++;
+                continue;
+            }
+            apply_row(&students[r], &rows[j].rec);
+            st->updated++;
+        }
+        if (w != r) students[w] = students[r];
+        w++;
+    }
+    count = w;
+
+    Placement *placed = NULL;
+    size_t nplaced = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (rows[i].tombstone || matched[i]) continue;
+        int id = rows[i].rec.id;
+        if (id > 0 && delta_lookup(&ix, id) != i) continue; /* superseded */
+        st->inserted++;
+        if (pos && pos[i] != NO_ROW) {
+            if (!placed) placed = malloc(n * sizeof(Placement));
+            if (!placed) alloc_failed();
+            placed[nplaced].pos = pos[i];
+            placed[nplaced].row = i;
+            nplaced++;
+            continue;
+        }
+        ensure_capacity();
+        students[count] = rows[i].rec;
+        students[count].id = id > 0 ? id : next_id++;
+        count++;
+    }
+
+    /* Placed rows go in with one backward pass: walking down from the new
+       end, each slot takes the placed row aimed at it (or past the end)
+       or else the next existing row. */
+    if (nplaced) {
+        if (nplaced > 1) qsort(placed, nplaced, sizeof(Placement), cmp_placement);
+        size_t total = count + nplaced;
+        if (total > capacity) resize_students(total, 1);
+        size_t src = count, k = nplaced;
+        for (size_t t = total; t-- > 0 && k > 0;) {
+            if (src == 0 || placed[k - 1].pos >= t) {
+                const StudentDelta *d = &rows[placed[k - 1].row];
+                students[t] = d->rec;
+                if (d->rec.id <= 0) students[t].id = next_id++;
+                k--;
+            } else {
+                students[t] = students[--src];
+            }
+        }
+        count = total;
+        free(placed);
+    }
+    free(matched);
+    free(ix.slots);
+    maybe_shrink();
+}
+
+static void merge_tree(const StudentDelta *rows, size_t n, MergeStats *st) {
+    /* same rule as the array: only the last row for an id counts */
+    DeltaIndex ix;
+    delta_index_build(&ix, rows, n);
+    for (size_t i = 0; i < n; ++i) {
+        const Student *src = &rows[i].rec;
+        if (src->id > 0 && delta_lookup(&ix, src->id) != i) continue; /* superseded */
+        if (rows[i].tombstone) {
+            if (bpt_remove(tree, src->id)) {
+                gradebook_remove(src->id);
+                st->deleted++;
+            }
+            continue;
+        }
+        Student *cur = src->id > 0 ? bpt_find(tree, src->id) : NULL;
+        if (cur) {
+            apply_row(cur, src);
+            st->updated++;
+            continue;
+        }
+        Student s = *src;
+        if (s.id <= 0) s.id = next_id++;
+        bpt_insert(tree, &s);
+        st->inserted++;
+    }
+    free(ix.slots);
+    invalidate_view();
+}
+
+void storage_merge(const StudentDelta *rows, size_t n, MergeStats *stats) {
+    storage_merge_at(rows, NULL, n, stats);
+}
+
+void storage_merge_at(const StudentDelta *rows, const size_t *pos, size_t n, MergeStats *stats) {
+    MergeStats st = {0, 0, 0};
+    if (backend == STORAGE_BACKEND_REMOTE) {
+        fprintf(stderr, "Merge import is not available in client mode\n");
+        n = 0;
+    }
+    if (rows && n > 0) {
+        /* explicit ids must never be handed out again */
+        for (size_t i = 0; i < n; ++i) {
+            if (!rows[i].tombstone && rows[i].rec.id >= next_id) next_id = rows[i].rec.id + 1;
+        }
+        if (backend == STORAGE_BACKEND_BPTREE) merge_tree(rows, n, &st);
+        else merge_array(rows, pos, n, &st);
+    }
+    if (stats) *stats = st;
 }
 
 /* Expose minimal internals to csv.c */
-Student *get_storage_array(void) { return students; }
-size_t get_storage_count(void) { return count; }
+Student *get_storage_array(void) {
+    if (backend == STORAGE_BACKEND_REMOTE) {
+        remote_refresh();
+        return view;
+    }
+    if (backend == STORAGE_BACKEND_BPTREE) {
+        build_view();
+        return view;
+    }
+    return students;
+}
+
+size_t get_storage_count(void) {
+    if (backend == STORAGE_BACKEND_REMOTE) {
+        size_t n = 0;
+        if (client_stats(remote, &n, NULL) < 0) remote_failed();
+        return n;
+    }
+    return backend == STORAGE_BACKEND_BPTREE ? bpt_size(tree) : count;
+}
+
+int get_storage_next_id(void) { return next_id; }
+
+int storage_request_save(void) {
+    if (backend != STORAGE_BACKEND_REMOTE) return -1;
+    int rc = client_save(remote);
+    if (rc < 0) remote_failed();
+    if (rc != STATUS_OK) fprintf(stderr, "Server failed to save\n");
+    else if (!quiet) puts("Server saved the roster.");
+    return rc == STATUS_OK ? 0 : -1;
+}
 
 void replace_storage_content(Student *arr, size_t new_count, int new_next_id) {
-    /* free old array (we choose to free the old one) and replace */
-    free(students);
-    students = arr;
-    count = new_count;
-    capacity = (arr != NULL) ? new_count : 0;
-    /* Ensure capacity has sensible minimum if we will add more later */
-    if (capacity < 8) capacity = 8;
+    if (backend == STORAGE_BACKEND_REMOTE) {
+        fprintf(stderr, "Loading is handled by the server in client mode\n");
+        free(arr);
+        return;
+    }
     next_id = new_next_id;
+    if (backend == STORAGE_BACKEND_BPTREE) {
+        bpt_clear(tree);
+        tree_insert_all(arr, new_count);
+        free(arr);
+        invalidate_view();
+        return;
+    }
+    release_students();
+    /* arr holds at least new_count records; that is all we may assume, and
+       the first add grows it with realloc */
+    students = arr;
+    count = arr ? new_count : 0;
+    capacity = count;
+}
+
+void storage_shrink_to_fit(void) {
+    /* a mapping stays one (its size rounds up to whole huge pages) */
+    if (backend == STORAGE_BACKEND_ARRAY) resize_students(count, students_mapped);
+    /* an id-order snapshot is cheap to rebuild, so drop it entirely */
+    if (backend == STORAGE_BACKEND_BPTREE && !view_sorted) {
+        free(view);
+        view = NULL;
+        view_count = 0;
+        view_cap = 0;
+        invalidate_view();
+    } else if (view && view_cap > view_count) {
+        resize_view(view_count);
+    }
 }
 
+void storage_memory_stats(StorageMemoryStats *out) {
+    if (!out) return;
+    memset(out, 0, sizeof(*out));
+    size_t snapshot = view_cap * sizeof(Student);
+    switch (backend) {
+    case STORAGE_BACKEND_ARRAY:
+        out->records = count;
+        out->reserved_bytes = students_mapped ? students_bytes : capacity * sizeof(Student);
+        out->huge_pages = students_mapped;
+        break;
+    case STORAGE_BACKEND_BPTREE:
+        out->records = bpt_size(tree);
+        out->reserved_bytes = bpt_memory(tree);
+        break;
+    case STORAGE_BACKEND_REMOTE:
+        /* only the local copy of the last listing */
+        out->records = view_count;
+        break;
+    }
+    out->used_bytes = out->records * sizeof(Student);
+    out->reserved_bytes += snapshot;
+}
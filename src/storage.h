@@ -12,21 +12,95 @@ typedef struct {
     double grade;
 } Student;
 
+/* Container behind the storage API. The flat array keeps insertion (or
+   last sort) order; the B+tree keeps records ordered by id and makes
+   insert/remove O(log n). Selected with GRADE_STORAGE=array|bptree.
+   The remote backend forwards every call to a grade_systemd server. */
+typedef enum {
+    STORAGE_BACKEND_ARRAY = 0,
+    STORAGE_BACKEND_BPTREE,
+    STORAGE_BACKEND_REMOTE
+} StorageBackend;
+
+/* One row of a merge import. A tombstone deletes rec.id; otherwise the
+   row updates the student with that id, or inserts it when absent
+   (id <= 0 inserts under the next free id). */
+typedef struct {
+    Student rec;
+    int tombstone;
+} StudentDelta;
+
+typedef struct {
+    size_t inserted;
+    size_t updated;
+    size_t deleted;
+} MergeStats;
+
+/* Memory held for records by this process */
+typedef struct {
+    size_t records;
+    size_t used_bytes;     /* records * sizeof(Student) */
+    size_t reserved_bytes; /* array block or tree nodes, plus any snapshot */
+    int huge_pages;        /* array is backed by transparent huge pages */
+} StorageMemoryStats;
+
+/* Visitor for scans; return nonzero to stop early */
+typedef int (*student_visit_fn)(const Student *s, void *user);
+
 /* lifecycle */
 void init_storage(void);
 void free_storage(void);
+/* switch container, moving current records over */
+void storage_set_backend(StorageBackend backend);
+/* drop local records and become a client of the server at socket_path;
+   returns 0 on success, -1 if the server is unreachable */
+int storage_connect(const char *socket_path);
+/* remote backend: ask the server to persist its roster */
+int storage_request_save(void);
+StorageBackend storage_get_backend(void);
+const char *storage_backend_name(void);
+/* suppress per-operation messages (bulk tools, benchmarks) */
+void storage_set_quiet(int quiet);
+/* Release spare capacity now instead of waiting for the shrink policy */
+void storage_shrink_to_fit(void);
+void storage_memory_stats(StorageMemoryStats *out);
 
 /* operations */
-void add_student(const char *name, double grade);
+/* returns the new id, or 0 if the student was not added */
+int add_student(const char *name, double grade);
 void remove_student(int id);
 void list_students(void);
 void sort_by_name(void);
 void sort_by_grade_desc();
 double compute_average(void);
 
+/* scans in current order; return the number of records visited */
+size_t storage_foreach(student_visit_fn fn, void *user);
+/* records with lo <= id <= hi (ascending id on the B+tree backend) */
+size_t storage_range_by_id(int lo, int hi, student_visit_fn fn, void *user);
+const Student *find_student(int id);
+/* Visit up to limit records starting at position offset of the current
+   order (as storage_foreach would reach them); returns the number
+   visited. The cost is O(limit): a slice of the array, of the B+tree's
+   snapshot (rebuilt only after a change), or one server request. */
+size_t storage_page(size_t offset, size_t limit, student_visit_fn fn, void *user);
+/* Position of id in the current order, or -1 if absent */
+long storage_position(int id);
+
+/* Apply delta rows in one pass; later rows win over earlier ones with the
+   same id. stats may be NULL. */
+void storage_merge(const StudentDelta *rows, size_t n, MergeStats *stats);
+/* As storage_merge, but on the array backend a row inserted with
+   pos[i] != SIZE_MAX lands at that position of the resulting order (or at
+   the end if it is past it) instead of being appended. Used to restore
+   removed rows where they were. */
+void storage_merge_at(const StudentDelta *rows, const size_t *pos, size_t n, MergeStats *stats);
+
 /* helpers used by csv.c (expose minimal internals) */
+/* On the B+tree backend this is a snapshot valid until the next change */
 Student *get_storage_array(void);
 size_t get_storage_count(void);
+int get_storage_next_id(void);
 /* replace_storage_content takes ownership of arr (caller allocated),
    new_next_id is the next id to use for newly added students */
 void replace_storage_content(Student *arr, size_t new_count, int new_next_id);
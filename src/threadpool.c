@@ -0,0 +1,340 @@
+/* src/threadpool.c — work-stealing thread pool and parallel merge sort */
+
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "threadpool.h"
+
+#define MAX_THREADS 256
+#define DEQUE_INITIAL 64
+
+/* Below these sizes the sort and merge run sequentially */
+#define SORT_CUTOFF 4096
+#define MERGE_CUTOFF 8192
+
+typedef struct {
+    task_fn fn;
+    void *arg;
+    TaskGroup *group;
+} Task;
+
+/* Ring buffer; the owner uses the tail end, thieves take from the head */
+typedef struct {
+    pthread_mutex_t lock;
+    Task **items;
+    size_t head;
+    size_t tail;
+    size_t cap;
+} Deque;
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_wake = PTHREAD_COND_INITIALIZER;
+static pthread_t *workers = NULL;
+/* one deque per worker plus one shared by threads outside the pool */
+static Deque *deques = NULL;
+static size_t nworkers = 0;
+static atomic_size_t nthreads;
+static atomic_size_t queued;
+static int stopping = 0;
+
+static _Thread_local int self = -1;
+
+static void *xmalloc(size_t n) {
+    void *p = malloc(n);
+    if (!p) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
+
+static void deque_push(Deque *d, Task *t) {
+    pthread_mutex_lock(&d->lock);
+    if (d->tail - d->head == d->cap) {
+        size_t newcap = d->cap ? d->cap * 2 : DEQUE_INITIAL;
+        Task **items = xmalloc(newcap * sizeof(Task *));
+        for (size_t i = d->head; i < d->tail; ++i) items[i & (newcap - 1)] = d->items[i & (d->cap - 1)];
+        free(d->items);
+        d->items = items;
+        d->cap = newcap;
+    }
+    d->items[d->tail & (d->cap - 1)] = t;
+    d->tail++;
+    pthread_mutex_unlock(&d->lock);
+}
+
+static Task *deque_pop(Deque *d) {
+    Task *t = NULL;
+    pthread_mutex_lock(&d->lock);
+    if (d->tail != d->head) t = d->items[--d->tail & (d->cap - 1)];
+    pthread_mutex_unlock(&d->lock);
+    return t;
+}
+
+static Task *deque_steal(Deque *d) {
+    Task *t = NULL;
+    pthread_mutex_lock(&d->lock);
+    if (d->tail != d->head) t = d->items[d->head++ & (d->cap - 1)];
+    pthread_mutex_unlock(&d->lock);
+    return t;
+}
+
+static size_t own_deque(void) {
+    return self >= 0 ? (size_t)self : nworkers;
+}
+
+/* Own deque first, then steal round-robin from the others */
+static Task *find_task(void) {
+    if (atomic_load(&queued) == 0) return NULL;
+    size_t mine = own_deque();
+    Task *t = deque_pop(&deques[mine]);
+    for (size_t i = 1; !t && i <= nworkers; ++i)
+        t = deque_steal(&deques[(mine + i) % (nworkers + 1)]);
+    if (t) atomic_fetch_sub(&queued, 1);
+    return t;
+}
+
+static void run_task(Task *t) {
+    TaskGroup *g = t->group;
+    t->fn(t->arg);
+    free(t);
+    atomic_fetch_sub(&g->pending, 1);
+}
+
+static void *worker_main(void *arg) {
+    self = (int)(size_t)arg;
+    for (;;) {
+        Task *t = find_task();
+        if (t) {
+            run_task(t);
+            continue;
+        }
+        pthread_mutex_lock(&pool_lock);
+        while (atomic_load(&queued) == 0 && !stopping)
+            pthread_cond_wait(&pool_wake, &pool_lock);
+        int stop = stopping && atomic_load(&queued) == 0;
+        pthread_mutex_unlock(&pool_lock);
+        if (stop) break;
+    }
+    return NULL;
+}
+
+static size_t configured_threads(void) {
+    long n = 0;
+    const char *env = getenv("GRADE_THREADS");
+    if (env) n = strtol(env, NULL, 10);
+    if (n <= 0) n = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n <= 0) n = 1;
+    if (n > MAX_THREADS) n = MAX_THREADS;
+    return (size_t)n;
+}
+
+/* Start the workers on first use. The calling thread counts as one of
+   the threads since it helps while waiting. */
+static void pool_start(void) {
+    if (atomic_load(&nthreads)) return;
+    pthread_mutex_lock(&pool_lock);
+    if (!atomic_load(&nthreads)) {
+        size_t want = configured_threads();
+        nworkers = want - 1;
+        deques = calloc(nworkers + 1, sizeof(Deque));
+        workers = calloc(nworkers ? nworkers : 1, sizeof(pthread_t));
+        if (!deques || !workers) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+        for (size_t i = 0; i <= nworkers; ++i) pthread_mutex_init(&deques[i].lock, NULL);
+        atomic_store(&queued, 0);
+        stopping = 0;
+        size_t started = 0;
+        for (; started < nworkers; ++started) {
+            if (pthread_create(&workers[started], NULL, worker_main, (void *)started) != 0) break;
+        }
+        if (started < nworkers) {
+            fprintf(stderr, "Warning: started only %zu of %zu pool threads\n", started, nworkers);
+            nworkers = started;
+        }
+        atomic_store(&nthreads, nworkers + 1);
+    }
+    pthread_mutex_unlock(&pool_lock);
+}
+
+size_t pool_thread_count(void) {
+    pool_start();
+    return atomic_load(&nthreads);
+}
+
+void pool_group_init(TaskGroup *g) {
+    atomic_init(&g->pending, 0);
+}
+
+void pool_spawn(TaskGroup *g, task_fn fn, void *arg) {
+    pool_start();
+    if (nworkers == 0) {
+        fn(arg);
+        return;
+    }
+    Task *t = xmalloc(sizeof(Task));
+    t->fn = fn;
+    t->arg = arg;
+    t->group = g;
+    atomic_fetch_add(&g->pending, 1);
+    deque_push(&deques[own_deque()], t);
+    atomic_fetch_add(&queued, 1);
+    pthread_mutex_lock(&pool_lock);
+    pthread_cond_signal(&pool_wake);
+    pthread_mutex_unlock(&pool_lock);
+}
+
+void pool_wait(TaskGroup *g) {
+    while (atomic_load(&g->pending) > 0) {
+        Task *t = find_task();
+        if (t) run_task(t);
+        else sched_yield();
+    }
+}
+
+void pool_shutdown(void) {
+    if (!atomic_load(&nthreads)) return;
+    pthread_mutex_lock(&pool_lock);
+    stopping = 1;
+    pthread_cond_broadcast(&pool_wake);
+    pthread_mutex_unlock(&pool_lock);
+    for (size_t i = 0; i < nworkers; ++i) pthread_join(workers[i], NULL);
+    for (size_t i = 0; i <= nworkers; ++i) {
+        pthread_mutex_destroy(&deques[i].lock);
+        free(deques[i].items);
+    }
+    free(deques);
+    free(workers);
+    deques = NULL;
+    workers = NULL;
+    nworkers = 0;
+    atomic_store(&nthreads, 0);
+}
+
+/* ---- parallel merge sort ----
+   Halves are sorted into the opposite buffer and merged back, so each
+   level moves the data once. Merges split around the median of the longer
+   run (binary-searched in the other) and run both halves in parallel. */
+
+typedef struct {
+    size_t size;
+    int (*cmp)(const void *, const void *);
+} SortSpec;
+
+typedef struct {
+    const SortSpec *spec;
+    char *src;
+    char *tmp;
+    size_t n;
+    int to_tmp;
+} SortJob;
+
+typedef struct {
+    const SortSpec *spec;
+    const char *a;
+    size_t na;
+    const char *b;
+    size_t nb;
+    char *out;
+} MergeJob;
+
+/* first index in b whose element is >= key (strict = 1) or > key */
+static size_t search(const SortSpec *sp, const char *b, size_t nb, const char *key, int strict) {
+    size_t lo = 0, hi = nb;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        int c = sp->cmp(b + mid * sp->size, key);
+        if (c < 0 || (!strict && c == 0)) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+static void merge_task(void *arg) {
+    MergeJob *m = arg;
+    const SortSpec *sp = m->spec;
+    size_t sz = sp->size;
+
+    if (m->na + m->nb <= MERGE_CUTOFF) {
+        const char *a = m->a, *ae = m->a + m->na * sz;
+        const char *b = m->b, *be = m->b + m->nb * sz;
+        char *out = m->out;
+        while (a < ae && b < be) {
+            /* ties take from the left run */
+            if (sp->cmp(b, a) < 0) { memcpy(out, b, sz); b += sz; }
+            else { memcpy(out, a, sz); a += sz; }
+            out += sz;
+        }
+        memcpy(out, a, (size_t)(ae - a));
+        memcpy(out + (ae - a), b, (size_t)(be - b));
+        return;
+    }
+
+    size_t ma, mb;
+    if (m->na >= m->nb) {
+        ma = m->na / 2;
+        mb = search(sp, m->b, m->nb, m->a + ma * sz, 1);
+    } else {
+        mb = m->nb / 2;
+        ma = search(sp, m->a, m->na, m->b + mb * sz, 0);
+    }
+    MergeJob left = { sp, m->a, ma, m->b, mb, m->out };
+    MergeJob right = { sp, m->a + ma * sz, m->na - ma, m->b + mb * sz, m->nb - mb,
+                       m->out + (ma + mb) * sz };
+    TaskGroup g;
+    pool_group_init(&g);
+    pool_spawn(&g, merge_task, &left);
+    merge_task(&right);
+    pool_wait(&g);
+}
+
+static void sort_task(void *arg) {
+    SortJob *j = arg;
+    const SortSpec *sp = j->spec;
+    size_t sz = sp->size;
+
+    if (j->n <= SORT_CUTOFF) {
+        qsort(j->src, j->n, sz, sp->cmp);
+        if (j->to_tmp) memcpy(j->tmp, j->src, j->n * sz);
+        return;
+    }
+
+    size_t h = j->n / 2;
+    SortJob left = { sp, j->src, j->tmp, h, !j->to_tmp };
+    SortJob right = { sp, j->src + h * sz, j->tmp + h * sz, j->n - h, !j->to_tmp };
+    TaskGroup g;
+    pool_group_init(&g);
+    pool_spawn(&g, sort_task, &left);
+    sort_task(&right);
+    pool_wait(&g);
+
+    char *from = j->to_tmp ? j->src : j->tmp;
+    char *to = j->to_tmp ? j->tmp : j->src;
+    MergeJob m = { sp, from, h, from + h * sz, j->n - h, to };
+    merge_task(&m);
+}
+
+void parallel_sort(void *base, size_t n, size_t size,
+                   int (*cmp)(const void *, const void *)) {
+    if (n <= SORT_CUTOFF || pool_thread_count() < 2) {
+        if (n > 1) qsort(base, n, size, cmp);
+        return;
+    }
+    char *tmp = malloc(n * size);
+    if (!tmp) {
+        /* no scratch space: fall back to the sequential sort */
+        qsort(base, n, size, cmp);
+        return;
+    }
+    SortSpec spec = { size, cmp };
+    SortJob job = { &spec, base, tmp, n, 0 };
+    sort_task(&job);
+    free(tmp);
+}
@@ -0,0 +1,35 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <stddef.h>
+#include <stdatomic.h>
+
+/* Shared work-stealing thread pool.
+   Each worker owns a deque: it pushes and pops its own tasks LIFO and
+   steals FIFO from the others when idle. Threads waiting on a group run
+   queued tasks instead of blocking, so tasks may spawn and wait on
+   subtasks (fork-join).
+
+   The pool starts on first use with GRADE_THREADS workers (default: one
+   per online CPU). With a single thread every task runs inline. */
+
+typedef void (*task_fn)(void *arg);
+
+/* Tracks tasks spawned together; zero-initialize or use pool_group_init */
+typedef struct {
+    atomic_size_t pending;
+} TaskGroup;
+
+size_t pool_thread_count(void);
+void pool_group_init(TaskGroup *g);
+void pool_spawn(TaskGroup *g, task_fn fn, void *arg);
+/* Block until every task in g has finished, helping out meanwhile */
+void pool_wait(TaskGroup *g);
+/* Stop and join the workers; the pool restarts on next use */
+void pool_shutdown(void);
+
+/* Parallel merge sort with the same contract as qsort (not stable) */
+void parallel_sort(void *base, size_t n, size_t size,
+                   int (*cmp)(const void *, const void *));
+
+#endif /* THREADPOOL_H */
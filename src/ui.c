@@ -2,6 +2,8 @@
 
 #define _POSIX_C_SOURCE 200809L
 
+#include <math.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -11,19 +13,29 @@
   #include <windows.h>
   #define is_atty _isatty
   #define STDOUT_FD _fileno(stdout)
+  #define STDIN_FD _fileno(stdin)
 #else
+  #include <poll.h>
+  #include <sys/ioctl.h>
   #include <unistd.h>
   #define is_atty isatty
   #define STDOUT_FD STDOUT_FILENO
+  #define STDIN_FD STDIN_FILENO
 #endif
 
 #include "ui.h"
 #include "storage.h"
 #include "csv.h"
+#include "command.h"
+#include "watch.h"
+#include "gradebook.h"
 
+/* Used when the terminal size cannot be queried */
 #define TERM_COLS 80
+#define TERM_ROWS 24
 #define NAME_COL_WIDTH 30
 #define GRADE_COL_WIDTH 7
+#define SCORE_COL_WIDTH 8
 
 /* Styling (enabled only when stdout is a TTY) */
 static int use_colors = 0;
@@ -66,11 +78,39 @@ static void clear_screen(void) {
     }
 }
 
+/* Terminal size in character cells, falling back to $LINES/$COLUMNS and
+   then to TERM_ROWS x TERM_COLS */
+static void term_size(int *rows, int *cols) {
+    *rows = 0;
+    *cols = 0;
+#ifdef _WIN32
+    CONSOLE_SCREEN_BUFFER_INFO info;
+    if (GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &info)) {
+        *rows = info.srWindow.Bottom - info.srWindow.Top + 1;
+        *cols = info.srWindow.Right - info.srWindow.Left + 1;
+    }
+#else
+    struct winsize ws;
+    if (ioctl(STDOUT_FD, TIOCGWINSZ, &ws) == 0) {
+        *rows = ws.ws_row;
+        *cols = ws.ws_col;
+    }
+#endif
+    const char *env;
+    if (*rows <= 0 && (env = getenv("LINES"))) *rows = atoi(env);
+    if (*cols <= 0 && (env = getenv("COLUMNS"))) *cols = atoi(env);
+    if (*rows <= 0) *rows = TERM_ROWS;
+    if (*cols <= 0) *cols = TERM_COLS;
+}
+
 /* Header and footer */
 static void draw_header(void) {
+    int rows, cols;
+    term_size(&rows, &cols);
+    if (cols > TERM_COLS) cols = TERM_COLS;
     char line[TERM_COLS + 1];
-    for (int i = 0; i < TERM_COLS; ++i) line[i] = '-';
-    line[TERM_COLS] = '\0';
+    for (int i = 0; i < cols; ++i) line[i] = '-';
+    line[cols] = '\0';
 
     if (use_colors) printf("%s%s%s\n", ANSI_DIM, line, ANSI_RESET);
     else puts(line);
@@ -88,17 +128,72 @@ static void draw_footer_hint(const char *hint) {
 }
 
 /* Safe line input */
-static void read_line(char *buf, size_t n) {
-    if (!fgets(buf, (int)n, stdin)) { buf[0] = '\0'; return; }
-    buf[strcspn(buf, "\r\n")] = '\0';
+/* Returns 0, or -1 if the line did not fit (the rest is discarded so it
+   cannot answer the next prompt) */
+static int read_line(char *buf, size_t n) {
+    if (!fgets(buf, (int)n, stdin)) { buf[0] = '\0'; return 0; }
+    size_t len = strcspn(buf, "\r\n");
+    int whole = buf[len] != '\0' || feof(stdin);
+    buf[len] = '\0';
+    if (whole) return 0;
+    int c;
+    while ((c = getchar()) != EOF && c != '\n') {}
+    return -1;
 }
 
-/* Prompt helper */
-static void prompt(const char *label, char *out, size_t n) {
+static void print_prompt(const char *label) {
     if (use_colors) printf("%s> %s%s", ANSI_PROMPT, label, ANSI_RESET);
     else printf("> %s", label);
     fflush(stdout);
-    read_line(out, n);
+}
+
+/* Prints one row per changed student, after a heading on the first */
+static void print_change(WatchChange kind, const Student *s, void *user) {
+    int *shown = user;
+    if (!*shown) {
+        *shown = 1;
+        putchar('\n');
+        if (use_colors) printf("%sData file changed:%s\n", ANSI_HEADER, ANSI_RESET);
+        else puts("Data file changed:");
+    }
+    const char *mark = kind == WATCH_ADDED ? "+" : kind == WATCH_UPDATED ? "~" : "-";
+    const char *color = kind == WATCH_REMOVED ? ANSI_WARN : ANSI_OK;
+    printf("%s%s %-5d %-*s %*.2f%s\n", color, mark, s->id, NAME_COL_WIDTH, s->name,
+           GRADE_COL_WIDTH - 1, s->grade, ANSI_RESET);
+}
+
+/* Wait for a line on stdin, applying outside edits to the data file
+   meanwhile. Only on a terminal: stdio may already hold lines read ahead
+   from a pipe, which poll cannot see. */
+static void wait_for_input(const char *label) {
+#ifndef _WIN32
+    if (watch_fd() < 0 || !is_atty(STDIN_FILENO)) return;
+    for (;;) {
+        struct pollfd fds[2] = {
+            { STDIN_FILENO, POLLIN, 0 },
+            { watch_fd(), POLLIN, 0 },
+        };
+        if (poll(fds, 2, -1) < 0) return;
+        if (fds[0].revents) return;
+        if (!fds[1].revents) continue;
+        int shown = 0;
+        if (watch_poll(print_change, &shown)) {
+            /* recorded batches would now undo the outside edit as well */
+            if (command_can_undo() || command_can_redo()) puts("Undo history cleared.");
+            command_reset();
+        }
+        if (shown) print_prompt(label);
+    }
+#else
+    (void)label;
+#endif
+}
+
+/* Prompt helper */
+static int prompt(const char *label, char *out, size_t n) {
+    print_prompt(label);
+    wait_for_input(label);
+    return read_line(out, n);
 }
 
 /* Confirmation prompt (y/n) */
@@ -114,10 +209,99 @@ static int confirm(const char *message) {
     }
 }
 
-/* Print table of students */
+/* Output for one screen is assembled here and written with one call */
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+} OutBuf;
+
+static void ob_printf(OutBuf *b, const char *fmt, ...) {
+    va_list ap;
+    for (;;) {
+        va_start(ap, fmt);
+        int n = vsnprintf(b->data ? b->data + b->len : NULL, b->cap - b->len, fmt, ap);
+        va_end(ap);
+        if (n < 0) return;
+        if ((size_t)n < b->cap - b->len) {
+            b->len += (size_t)n;
+            return;
+        }
+        size_t newcap = b->cap ? b->cap * 2 : 4096;
+        while (newcap < b->len + (size_t)n + 1) newcap *= 2;
+        char *tmp = realloc(b->data, newcap);
+        if (!tmp) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+        b->data = tmp;
+        b->cap = newcap;
+    }
+}
+
+static void ob_flush(OutBuf *b) {
+    fwrite(b->data, 1, b->len, stdout);
+    fflush(stdout);
+    b->len = 0;
+}
+
+typedef struct {
+    OutBuf *out;
+    size_t row;
+    int name_width;
+    int mark_id; /* row to highlight after a jump, 0 for none */
+} TableCtx;
+
+static int render_table_row(const Student *s, void *user) {
+    TableCtx *t = user;
+    OutBuf *b = t->out;
+    const char *style = "";
+    if (use_colors && s->id == t->mark_id) style = ANSI_BOLD;
+    else if (use_colors && t->row % 2 == 1) style = ANSI_DIM;
+    ob_printf(b, "%s%-5d %-*.*s %*.2f", style, s->id, t->name_width, t->name_width, s->name,
+              GRADE_COL_WIDTH - 1, s->grade);
+    for (size_t k = 0; k < gradebook_count(); ++k) {
+        double v = gradebook_score(s->id, k);
+        if (isnan(v)) ob_printf(b, " %*s", SCORE_COL_WIDTH, "-");
+        else ob_printf(b, " %*.2f", SCORE_COL_WIDTH, v);
+    }
+    ob_printf(b, "%s\n", *style ? ANSI_RESET : "");
+    t->row++;
+    return 0;
+}
+
+/* Name column width that fits the terminal next to the fixed columns */
+static int table_name_width(int cols) {
+    int fixed = 5 + 1 + 1 + GRADE_COL_WIDTH + (int)gradebook_count() * (SCORE_COL_WIDTH + 1);
+    int w = cols - 1 - fixed;
+    if (w > NAME_COL_WIDTH) w = NAME_COL_WIDTH;
+    if (w < 10) w = 10;
+    return w;
+}
+
+static void render_table_header(OutBuf *b, int name_width) {
+    size_t nassess = gradebook_count();
+    ob_printf(b, "%s%-5s %-*s %-*s", ANSI_BOLD, "ID", name_width, "Name", GRADE_COL_WIDTH, "Grade");
+    for (size_t k = 0; k < nassess; ++k)
+        ob_printf(b, " %*.*s", SCORE_COL_WIDTH, SCORE_COL_WIDTH, gradebook_name(k));
+    ob_printf(b, "%s\n", ANSI_RESET);
+    size_t width = 5 + 1 + (size_t)name_width + 1 + GRADE_COL_WIDTH + nassess * (SCORE_COL_WIDTH + 1);
+    for (size_t i = 0; i < width; ++i) ob_printf(b, "-");
+    ob_printf(b, "\n");
+}
+
+/* Header plus rows [offset, offset + rows) of the current order */
+static void render_page(OutBuf *b, size_t offset, size_t rows, int name_width, int mark_id) {
+    TableCtx t = { b, offset, name_width, mark_id };
+    render_table_header(b, name_width);
+    storage_page(offset, rows, render_table_row, &t);
+}
+
+/* Print table of students. On a terminal this is a pager that renders one
+   screen at a time, so its cost depends on the screen, not the roster;
+   otherwise every page is written out in turn. */
 static void print_students_table(void) {
     size_t cnt = get_storage_count();
-    Student *arr = get_storage_array();
 
     if (cnt == 0) {
         if (use_colors) printf("%sNo students found.%s\n", ANSI_DIM, ANSI_RESET);
@@ -125,17 +309,69 @@ static void print_students_table(void) {
         return;
     }
 
-    if (use_colors) printf("%s%-5s %-*s %-*s%s\n", ANSI_BOLD, "ID", NAME_COL_WIDTH, "Name", GRADE_COL_WIDTH, "Grade", ANSI_RESET);
-    else printf("%-5s %-*s %-*s\n", "ID", NAME_COL_WIDTH, "Name", GRADE_COL_WIDTH, "Grade");
+    int rows, cols;
+    term_size(&rows, &cols);
+    int name_width = table_name_width(cols);
+    OutBuf out = { NULL, 0, 0 };
+
+    if (!is_atty(STDIN_FD) || !is_atty(STDOUT_FD)) {
+        size_t chunk = 1024;
+        TableCtx t = { &out, 0, name_width, 0 };
+        render_table_header(&out, name_width);
+        for (size_t off = 0; off < cnt; off += chunk) {
+            storage_page(off, chunk, render_table_row, &t);
+            ob_flush(&out);
+        }
+        free(out.data);
+        return;
+    }
+
+    /* header, separator, status line and prompt take four lines */
+    size_t page_rows = rows > 9 ? (size_t)rows - 4 : 5;
+    size_t offset = 0;
+    int mark_id = 0;
+    char note[64] = "";
+    char cmd[32];
+    for (;;) {
+        cnt = get_storage_count();
+        if (cnt == 0) break;
+        if (offset >= cnt) offset = (cnt - 1) / page_rows * page_rows;
+        size_t pages = (cnt + page_rows - 1) / page_rows;
+        size_t last = offset + page_rows < cnt ? offset + page_rows : cnt;
 
-    for (int i = 0; i < 5 + 1 + NAME_COL_WIDTH + 1 + GRADE_COL_WIDTH; ++i) putchar('-');
-    putchar('\n');
+        if (use_colors) ob_printf(&out, "\x1b[2J\x1b[H");
+        render_page(&out, offset, page_rows, name_width, mark_id);
+        ob_printf(&out, "%sRows %zu-%zu of %zu, page %zu/%zu%s %s%s%s\n",
+                  ANSI_DIM, offset + 1, last, cnt, offset / page_rows + 1, pages, ANSI_RESET,
+                  ANSI_WARN, note, ANSI_RESET);
+        ob_flush(&out);
+        note[0] = '\0';
 
-    for (size_t i = 0; i < cnt; ++i) {
-        if (use_colors && (i % 2 == 1)) printf("%s", ANSI_DIM);
-        printf("%-5d %-*s %*.2f\n", arr[i].id, NAME_COL_WIDTH, arr[i].name, GRADE_COL_WIDTH - 1, arr[i].grade);
-        if (use_colors && (i % 2 == 1)) printf("%s", ANSI_RESET);
+        prompt("Enter/n next, p prev, <id> jump, q quit:", cmd, sizeof(cmd));
+        if (cmd[0] == 'q' || cmd[0] == 'Q') break;
+        if (cmd[0] == '\0' || cmd[0] == 'n' || cmd[0] == 'N') {
+            if (last >= cnt) break; /* past the last page */
+            offset += page_rows;
+            mark_id = 0;
+        } else if (cmd[0] == 'p' || cmd[0] == 'P') {
+            offset = offset >= page_rows ? offset - page_rows : 0;
+            mark_id = 0;
+        } else {
+            int id = atoi(cmd);
+            if (id <= 0) {
+                snprintf(note, sizeof(note), "(type n, p, q or a student id)");
+                continue;
+            }
+            long pos = storage_position(id);
+            if (pos < 0) {
+                snprintf(note, sizeof(note), "(no student with id %s)", cmd);
+                continue;
+            }
+            offset = (size_t)pos / page_rows * page_rows;
+            mark_id = id;
+        }
     }
+    free(out.data);
 }
 
 /* Show average */
@@ -151,6 +387,96 @@ static void show_average(void) {
     else printf("Class average: %.2f\n", avg);
 }
 
+/* Weights and per-assessment averages */
+static void show_assessments(void) {
+    size_t n = gradebook_count();
+    if (n == 0) {
+        if (use_colors) printf("%sNo assessments defined.%s\n", ANSI_DIM, ANSI_RESET);
+        else puts("No assessments defined.");
+        return;
+    }
+    if (use_colors) printf("%s", ANSI_BOLD);
+    printf("%-*s %8s %8s\n", ASSESSMENT_NAME_LEN, "Assessment", "Weight", "Average");
+    if (use_colors) printf("%s", ANSI_RESET);
+    for (size_t k = 0; k < n; ++k) {
+        double avg = gradebook_average(k);
+        printf("%-*s %8.2f ", ASSESSMENT_NAME_LEN, gradebook_name(k), gradebook_weight(k));
+        if (isnan(avg)) printf("%8s\n", "-");
+        else printf("%8.2f\n", avg);
+    }
+}
+
+/* Ask for an assessment by name; returns its index or -1 */
+static int prompt_assessment(void) {
+    char name[ASSESSMENT_NAME_LEN + 8];
+    prompt("Assessment name:", name, sizeof(name));
+    int k = gradebook_find(name);
+    if (k < 0) {
+        if (use_colors) printf("%sNo such assessment.%s\n", ANSI_WARN, ANSI_RESET);
+        else puts("No such assessment.");
+    }
+    return k;
+}
+
+static void assessments_menu(void) {
+    /* the protocol carries no assessments, so edits here would reach nobody */
+    if (storage_get_backend() == STORAGE_BACKEND_REMOTE) {
+        if (use_colors) printf("%sAssessments are not available in client mode.%s\n", ANSI_WARN, ANSI_RESET);
+        else puts("Assessments are not available in client mode.");
+        return;
+    }
+    show_assessments();
+    char choice[8];
+    prompt("a) Add  w) Set weight  s) Set score  (Enter to go back):", choice, sizeof(choice));
+
+    if (choice[0] == 'a') {
+        char name[ASSESSMENT_NAME_LEN + 8];
+        char weight_str[32];
+        prompt("Assessment name:", name, sizeof(name));
+        prompt("Weight:", weight_str, sizeof(weight_str));
+        double w = atof(weight_str);
+        if (w < 0 || gradebook_add_assessment(name, w) < 0) {
+            if (use_colors) printf("%sInvalid or duplicate assessment.%s\n", ANSI_WARN, ANSI_RESET);
+            else puts("Invalid or duplicate assessment.");
+            return;
+        }
+        if (use_colors) printf("%sAdded assessment %s.%s\n", ANSI_OK, name, ANSI_RESET);
+        else printf("Added assessment %s.\n", name);
+    }
+    else if (choice[0] == 'w') {
+        int k = prompt_assessment();
+        if (k < 0) return;
+        char weight_str[32];
+        prompt("Weight:", weight_str, sizeof(weight_str));
+        if (command_set_weight((size_t)k, atof(weight_str)) != 0) {
+            if (use_colors) printf("%sInvalid weight.%s\n", ANSI_WARN, ANSI_RESET);
+            else puts("Invalid weight.");
+            return;
+        }
+        command_commit(NULL);
+        if (use_colors) printf("%sWeighted finals recomputed.%s\n", ANSI_OK, ANSI_RESET);
+        else puts("Weighted finals recomputed.");
+    }
+    else if (choice[0] == 's') {
+        char idstr[16];
+        char score_str[32];
+        prompt("Student ID:", idstr, sizeof(idstr));
+        int id = atoi(idstr);
+        int k = prompt_assessment();
+        if (k < 0) return;
+        prompt("Score (0-100, empty to clear):", score_str, sizeof(score_str));
+        double v = score_str[0] ? atof(score_str) : NAN;
+        if ((!isnan(v) && (v < 0 || v > 100)) || command_set_score(id, (size_t)k, v) != 0) {
+            if (use_colors) printf("%sInvalid student or score.%s\n", ANSI_WARN, ANSI_RESET);
+            else puts("Invalid student or score.");
+            return;
+        }
+        command_commit(NULL);
+        if (use_colors) printf("%sScore recorded.%s\n", ANSI_OK, ANSI_RESET);
+        else puts("Score recorded.");
+    }
+}
+
 /* Public menu implementation */
 void menu(void) {
     init_style();
@@ -165,9 +491,12 @@ void menu(void) {
                    ANSI_BOLD, ANSI_RESET, ANSI_BOLD, ANSI_RESET, ANSI_BOLD, ANSI_RESET, ANSI_BOLD);
             printf("%s5) Save%s   %s6) Sort name%s   %s7) Sort grade%s   %s8) Exit%s\n",
                    ANSI_BOLD, ANSI_RESET, ANSI_BOLD, ANSI_RESET, ANSI_BOLD, ANSI_RESET, ANSI_BOLD, ANSI_RESET);
+            printf("%s9) Merge delta CSV%s   %s10) Assessments%s   %s11) Undo%s   %s12) Redo%s\n",
+                   ANSI_BOLD, ANSI_RESET, ANSI_BOLD, ANSI_RESET, ANSI_BOLD, ANSI_RESET, ANSI_BOLD, ANSI_RESET);
         } else {
             printf("1) List   2) Add   3) Remove   4) Average\n");
             printf("5) Save   6) Sort name   7) Sort grade   8) Exit\n");
+            printf("9) Merge delta CSV   10) Assessments   11) Undo   12) Redo\n");
         }
 
         prompt("Choose:", choice, sizeof(choice));
@@ -196,20 +525,44 @@ void menu(void) {
                 continue;
             }
 
-            add_student(name, g);
+            int id = command_add(name, g);
+            if (command_commit(NULL)) printf("Added student (id=%d)\n", id);
         }
         else if (strcmp(choice, "3") == 0) {
-            char idstr[16];
-            prompt("ID to remove:", idstr, sizeof(idstr));
-            int id = atoi(idstr);
-            if (id <= 0) {
-                if (use_colors) printf("%sInvalid ID.%s\n", ANSI_WARN, ANSI_RESET);
-                else puts("Invalid ID.");
+            char idstr[1024];
+            /* every id takes a digit and a separator, so this always fits */
+            int ids[sizeof(idstr) / 2];
+            size_t nids = 0;
+            if (prompt("ID(s) to remove:", idstr, sizeof(idstr)) != 0) {
+                if (use_colors) printf("%sToo many IDs at once (at most %zu characters).%s\n",
+                                       ANSI_WARN, sizeof(idstr) - 2, ANSI_RESET);
+                else printf("Too many IDs at once (at most %zu characters).\n", sizeof(idstr) - 2);
+                continue;
+            }
+            const char *bad = NULL;
+            for (char *tok = strtok(idstr, " ,"); tok; tok = strtok(NULL, " ,")) {
+                int id = atoi(tok);
+                if (id <= 0) { bad = tok; break; }
+                ids[nids++] = id;
+            }
+            if (bad || nids == 0) {
+                if (use_colors) printf("%sInvalid ID%s%s.%s\n", ANSI_WARN, bad ? ": " : "", bad ? bad : "", ANSI_RESET);
+                else printf("Invalid ID%s%s.\n", bad ? ": " : "", bad ? bad : "");
                 continue;
             }
             char msg[128];
-            snprintf(msg, sizeof(msg), "Delete student %d? (y/n)", id);
-            if (confirm(msg)) remove_student(id);
+            if (nids == 1) snprintf(msg, sizeof(msg), "Delete student %d? (y/n)", ids[0]);
+            else snprintf(msg, sizeof(msg), "Delete %zu students? (y/n)", nids);
+            if (confirm(msg)) {
+                /* one batch however many ids were given */
+                for (size_t i = 0; i < nids; ++i) command_remove(ids[i]);
+                MergeStats st;
+                if (command_commit(&st)) {
+                    if (nids > 1) printf("Removed %zu of %zu students\n", st.deleted, nids);
+                    else if (st.deleted) printf("Removed student id %d\n", ids[0]);
+                    else printf("No student with id %d\n", ids[0]);
+                }
+            }
             else {
                 if (use_colors) printf("%sCancelled.%s\n", ANSI_DIM, ANSI_RESET);
                 else puts("Cancelled.");
@@ -227,6 +580,38 @@ void menu(void) {
         else if (strcmp(choice, "7") == 0) {
             sort_by_grade_desc();
         }
+        else if (strcmp(choice, "9") == 0) {
+            char path[256];
+            prompt("Delta file:", path, sizeof(path));
+            if (strlen(path) == 0) {
+                if (use_colors) printf("%sCancelled.%s\n", ANSI_DIM, ANSI_RESET);
+                else puts("Cancelled.");
+                continue;
+            }
+            StudentDelta *rows;
+            size_t n;
+            if (read_delta_file(path, &rows, &n) != 0) continue;
+            int queued_ok = command_merge(rows, n) == 0;
+            free(rows);
+            if (!queued_ok) continue; /* command_merge said why */
+            MergeStats st;
+            if (command_commit(&st))
+                printf("Merged %s: %zu inserted, %zu updated, %zu deleted\n",
+                       path, st.inserted, st.updated, st.deleted);
+        }
+        else if (strcmp(choice, "10") == 0) {
+            assessments_menu();
+        }
+        else if (strcmp(choice, "11") == 0 || strcmp(choice, "12") == 0) {
+            int undo = choice[1] == '1';
+            if ((undo ? command_undo() : command_redo()) != 0) {
+                if (use_colors) printf("%sNothing to %s.%s\n", ANSI_DIM, undo ? "undo" : "redo", ANSI_RESET);
+                else printf("Nothing to %s.\n", undo ? "undo" : "redo");
+            } else {
+                if (use_colors) printf("%s%s.%s\n", ANSI_OK, undo ? "Undone" : "Redone", ANSI_RESET);
+                else puts(undo ? "Undone." : "Redone.");
+            }
+        }
         else if (strcmp(choice, "8") == 0) {
             if (confirm("Save changes and exit? (y/n)")) {
                 save_to_file("data/students.csv");
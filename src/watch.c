@@ -0,0 +1,479 @@
+/* src/watch.c — inotify watch on the data file with incremental reload */
+
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+#include "watch.h"
+#include "csv.h"
+#include "csvscan.h"
+#include "gradebook.h"
+#include "storage.h"
+
+static int wfd = -1;
+static char *wpath = NULL;   /* file as given to watch_start */
+static char *wname = NULL;   /* its basename, matched against events */
+/* content we last loaded or wrote; edits are diffed against it */
+static char *base = NULL;
+static size_t base_len = 0;
+
+/* A parsed row with its score columns (NAN when missing) */
+typedef struct {
+    Student rec;
+    double scores[MAX_ASSESSMENTS];
+} Row;
+
+typedef struct {
+    Row *items;
+    size_t count;
+    size_t cap;
+} RowList;
+
+typedef struct {
+    StudentDelta *items;
+    double (*scores)[MAX_ASSESSMENTS]; /* per item */
+    size_t count;
+    size_t cap;
+} DeltaList;
+
+/* Read a whole file; returns NULL if it cannot be opened */
+static char *read_file(const char *path, size_t *out_len) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    size_t cap = 4096, len = 0;
+    char *buf = malloc(cap);
+    if (!buf) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    size_t got;
+    while ((got = fread(buf + len, 1, cap - len, f)) > 0) {
+        len += got;
+        if (len == cap) {
+            cap *= 2;
+            char *tmp = realloc(buf, cap);
+            if (!tmp) {
+                fprintf(stderr, "Memory allocation failed\n");
+                exit(EXIT_FAILURE);
+            }
+            buf = tmp;
+        }
+    }
+    fclose(f);
+    *out_len = len;
+    return buf;
+}
+
+static void set_base(char *content, size_t len) {
+    free(base);
+    base = content;
+    base_len = len;
+}
+
+int watch_start(const char *filename) {
+    if (!filename || wfd >= 0) return wfd;
+    /* the server owns the file in client mode */
+    if (storage_get_backend() == STORAGE_BACKEND_REMOTE) return -1;
+#ifndef __linux__
+    /* inotify only; elsewhere the file is read at startup as before */
+    return -1;
+#else
+    const char *slash = strrchr(filename, '/');
+    char dir[PATH_MAX];
+    if (slash) {
+        size_t n = (size_t)(slash - filename);
+        if (n == 0) n = 1; /* file in / */
+        if (n >= sizeof(dir)) return -1;
+        memcpy(dir, filename, n);
+        dir[n] = '\0';
+    } else {
+        strcpy(dir, ".");
+    }
+
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+        perror("inotify_init1");
+        return -1;
+    }
+    /* Watch the directory: editors and our own save replace the file, which
+       would silently end a watch on the file itself. */
+    if (inotify_add_watch(fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        perror("inotify_add_watch");
+        close(fd);
+        return -1;
+    }
+    wpath = strdup(filename);
+    wname = strdup(slash ? slash + 1 : filename);
+    if (!wpath || !wname) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    wfd = fd;
+    watch_sync(filename);
+    return wfd;
+#endif
+}
+
+void watch_stop(void) {
+    if (wfd >= 0) close(wfd);
+    wfd = -1;
+    free(wpath);
+    free(wname);
+    wpath = NULL;
+    wname = NULL;
+    set_base(NULL, 0);
+}
+
+int watch_fd(void) {
+    return wfd;
+}
+
+void watch_sync(const char *filename) {
+    if (wfd < 0 || !filename || strcmp(filename, wpath) != 0) return;
+    size_t len = 0;
+    char *content = read_file(wpath, &len);
+    if (!content) len = 0;
+    set_base(content, len);
+}
+
+/* Consume every queued event; returns 1 if one concerned our file */
+static int drain_events(void) {
+    int hit = 0;
+#ifdef __linux__
+    /* aligned as inotify(7) requires */
+    char buf[16 * (sizeof(struct inotify_event) + NAME_MAX + 1)]
+        __attribute__((aligned(__alignof__(struct inotify_event))));
+    for (;;) {
+        ssize_t n = read(wfd, buf, sizeof(buf));
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) continue;
+            break;
+        }
+        for (char *p = buf; p < buf + n;) {
+            const struct inotify_event *ev = (const struct inotify_event *)p;
+            if (ev->len && strcmp(ev->name, wname) == 0) hit = 1;
+            if (ev->mask & IN_Q_OVERFLOW) hit = 1;
+            p += sizeof(struct inotify_event) + ev->len;
+        }
+    }
+#endif
+    return hit;
+}
+
+/* Offset of the record after the one starting at r */
+static size_t next_record(const char *s, size_t len, size_t r) {
+    const char *e = scan_record_end(s + r, s + len);
+    return e < s + len ? (size_t)(e - s) + 1 : len;
+}
+
+/* Parse the complete records in s[0, len), with ncols score columns */
+static void parse_region(const char *s, size_t len, size_t ncols, RowList *out) {
+    char *buf = malloc(len + 1);
+    if (!buf) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(buf, s, len);
+    buf[len] = '\0';
+    char *cursor = buf, *line;
+    size_t n;
+    while ((line = scan_next_record(&cursor, buf + len, &n))) {
+        Row row;
+        if (strncmp(line, "id,", 3) == 0) continue; /* header */
+        if (!parse_student_scores(line, &row.rec, row.scores, ncols) || row.rec.id <= 0) {
+            fprintf(stderr, "Warning: failed to parse line: %s\n", line);
+            continue;
+        }
+        if (out->count == out->cap) {
+            out->cap = out->cap ? out->cap * 2 : 16;
+            Row *tmp = realloc(out->items, out->cap * sizeof(Row));
+            if (!tmp) {
+                fprintf(stderr, "Memory allocation failed\n");
+                exit(EXIT_FAILURE);
+            }
+            out->items = tmp;
+        }
+        out->items[out->count++] = row;
+    }
+    free(buf);
+}
+
+static int cmp_id(const void *a, const void *b) {
+    int x = ((const Row *)a)->rec.id, y = ((const Row *)b)->rec.id;
+    return (x > y) - (x < y);
+}
+
+static void push_delta(DeltaList *d, const Row *row, int tombstone) {
+    if (d->count == d->cap) {
+        d->cap = d->cap ? d->cap * 2 : 16;
+        StudentDelta *tmp = realloc(d->items, d->cap * sizeof(StudentDelta));
+        double (*stmp)[MAX_ASSESSMENTS] = realloc(d->scores, d->cap * sizeof(*d->scores));
+        if (!tmp || !stmp) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+        d->items = tmp;
+        d->scores = stmp;
+    }
+    d->items[d->count].rec = row->rec;
+    d->items[d->count].tombstone = tombstone;
+    memcpy(d->scores[d->count], row->scores, sizeof(row->scores));
+    d->count++;
+}
+
+static int same_score(double a, double b) {
+    return a == b || (isnan(a) && isnan(b));
+}
+
+/* Rows present in both regions with identical fields are moves, not edits */
+static int same_row(const Row *a, const Row *b, size_t ncols) {
+    if (a->rec.grade != b->rec.grade || strcmp(a->rec.name, b->rec.name) != 0) return 0;
+    for (size_t k = 0; k < ncols; ++k) {
+        if (!same_score(a->scores[k], b->scores[k])) return 0;
+    }
+    return 1;
+}
+
+/* Diff old against new by id: the byte ranges both versions share at the
+   start and end are skipped, so an append or a one-line edit parses only
+   the records that changed. */
+static void diff_content(const char *old, size_t olen, const char *new, size_t nlen,
+                         size_t ncols, DeltaList *out) {
+    size_t lim = olen < nlen ? olen : nlen;
+    size_t same = 0;
+    while (same < lim && old[same] == new[same]) same++;
+    size_t suf = 0;
+    while (suf < lim - same && old[olen - 1 - suf] == new[nlen - 1 - suf]) suf++;
+
+    /* Both cuts must be record starts in both versions (a newline may sit
+       inside a quoted name). Walk the records from the top while the two
+       versions split them alike and before the first difference... */
+    size_t pre = 0;
+    for (;;) {
+        size_t o = next_record(old, olen, pre), n = next_record(new, nlen, pre);
+        if (o != n || o > same || o == pre) break;
+        pre = o;
+    }
+    /* ...then on in step until both reach a record start the same distance
+       from their ends, inside the shared suffix */
+    size_t ro = pre, rn = pre;
+    while (olen - ro != nlen - rn || olen - ro > suf) {
+        if (olen - ro >= nlen - rn) ro = next_record(old, olen, ro);
+        else rn = next_record(new, nlen, rn);
+    }
+    suf = olen - ro;
+
+    RowList before = {0}, after = {0};
+    parse_region(old + pre, olen - suf - pre, ncols, &before);
+    parse_region(new + pre, nlen - suf - pre, ncols, &after);
+    if (before.count > 1) qsort(before.items, before.count, sizeof(Row), cmp_id);
+    if (after.count > 1) qsort(after.items, after.count, sizeof(Row), cmp_id);
+
+    size_t i = 0, j = 0;
+    while (i < before.count || j < after.count) {
+        if (j == after.count || (i < before.count && before.items[i].rec.id < after.items[j].rec.id)) {
+            push_delta(out, &before.items[i++], 1);
+        } else if (i == before.count || after.items[j].rec.id < before.items[i].rec.id) {
+            push_delta(out, &after.items[j++], 0);
+        } else {
+            if (!same_row(&before.items[i], &after.items[j], ncols)) push_delta(out, &after.items[j], 0);
+            i++;
+            j++;
+        }
+    }
+    free(before.items);
+    free(after.items);
+}
+
+/* Current record of every id in a delta, found in one pass over the
+   array (find_student is a scan there) or one lookup per id on the
+   B+tree. Open addressing with linear probing. */
+enum { SLOT_EMPTY, SLOT_WANTED, SLOT_FOUND };
+
+typedef struct {
+    int id;
+    int state;
+    Student rec;
+} CurrentSlot;
+
+typedef struct {
+    CurrentSlot *slots;
+    size_t mask;
+    size_t wanted; /* ids not found yet */
+} CurrentIndex;
+
+static CurrentSlot *current_slot(const CurrentIndex *ix, int id) {
+    size_t h = (size_t)((unsigned int)id * 2654435761u) & ix->mask;
+    while (ix->slots[h].state != SLOT_EMPTY && ix->slots[h].id != id) h = (h + 1) & ix->mask;
+    return &ix->slots[h];
+}
+
+static int note_current(const Student *s, void *user) {
+    CurrentIndex *ix = user;
+    CurrentSlot *slot = current_slot(ix, s->id);
+    if (slot->state != SLOT_WANTED) return 0;
+    slot->rec = *s;
+    slot->state = SLOT_FOUND;
+    return --ix->wanted == 0; /* stop once every id is found */
+}
+
+static void find_current(const DeltaList *d, CurrentIndex *ix) {
+    size_t cap = 16;
+    while (cap < d->count * 2) cap *= 2;
+    ix->slots = calloc(cap, sizeof(CurrentSlot));
+    if (!ix->slots) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    ix->mask = cap - 1;
+    ix->wanted = 0;
+    for (size_t k = 0; k < d->count; ++k) {
+        CurrentSlot *slot = current_slot(ix, d->items[k].rec.id);
+        if (slot->state != SLOT_EMPTY) continue;
+        slot->id = d->items[k].rec.id;
+        slot->state = SLOT_WANTED;
+        ix->wanted++;
+    }
+    if (storage_get_backend() == STORAGE_BACKEND_BPTREE) {
+        for (size_t h = 0; h < cap; ++h) {
+            if (ix->slots[h].state != SLOT_WANTED) continue;
+            const Student *s = find_student(ix->slots[h].id);
+            if (s) note_current(s, ix);
+        }
+    } else if (ix->wanted) {
+        storage_foreach(note_current, ix);
+    }
+}
+
+/* Rows can be diffed in place only while the file has the gradebook's
+   assessment columns; weights may change. Returns 0 and the header's
+   weights, or -1 if the columns differ. */
+static int read_weights(const char *content, size_t len, double *weights) {
+    char names[MAX_ASSESSMENTS][ASSESSMENT_NAME_LEN];
+    size_t cols = 0;
+    if (len >= 3 && strncmp(content, "id,", 3) == 0) {
+        const char *nl = memchr(content, '\n', len);
+        size_t n = nl ? (size_t)(nl - content) : len;
+        if (n > 0 && content[n - 1] == '\r') n--;
+        char *line = malloc(n + 1);
+        if (!line) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+        memcpy(line, content, n);
+        line[n] = '\0';
+        cols = parse_csv_header(line, names, weights, MAX_ASSESSMENTS);
+        free(line);
+    }
+    if (cols != gradebook_count()) return -1;
+    for (size_t k = 0; k < cols; ++k) {
+        if (strcmp(names[k], gradebook_name(k)) != 0) return -1;
+    }
+    return 0;
+}
+
+typedef struct {
+    const CurrentIndex *ix;
+    watch_change_fn fn;
+    void *user;
+    size_t count;
+} Reweighed;
+
+/* New weights change the final of every student with scores; the rows
+   of the delta are reported on their own */
+static int report_reweighed(const Student *s, void *user) {
+    Reweighed *r = user;
+    if (!gradebook_final(s->id, NULL) || current_slot(r->ix, s->id)->state != SLOT_EMPTY) return 0;
+    if (r->fn) r->fn(WATCH_UPDATED, s, r->user);
+    r->count++;
+    return 0;
+}
+
+size_t watch_poll(watch_change_fn fn, void *user) {
+    if (wfd < 0 || !drain_events()) return 0;
+
+    size_t len = 0;
+    char *content = read_file(wpath, &len);
+    /* deleted or mid-replace: keep the roster, wait for the next write */
+    if (!content) return 0;
+    if (len == base_len && memcmp(content, base, len) == 0) {
+        free(content);
+        return 0;
+    }
+
+    /* added, removed or renamed assessments move every score column */
+    size_t ncols = gradebook_count();
+    double weights[MAX_ASSESSMENTS];
+    if (read_weights(content, len, weights) != 0) {
+        fprintf(stderr, "Warning: the assessments in %s changed; restart to load them\n", wpath);
+        free(content);
+        return 0;
+    }
+    int reweigh = 0;
+    for (size_t k = 0; k < ncols; ++k) {
+        if (weights[k] != gradebook_weight(k)) reweigh = 1;
+    }
+
+    DeltaList d = {0};
+    diff_content(base ? base : "", base_len, content, len, ncols, &d);
+    set_base(content, len);
+    if (d.count == 0 && !reweigh) return 0;
+
+    /* classify against the roster before the merge touches it; removals
+       of ids that are already gone locally are dropped */
+    WatchChange *kinds = malloc((d.count ? d.count : 1) * sizeof(WatchChange));
+    if (!kinds) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    CurrentIndex ix;
+    find_current(&d, &ix);
+    size_t kept = 0;
+    for (size_t k = 0; k < d.count; ++k) {
+        const CurrentSlot *slot = current_slot(&ix, d.items[k].rec.id);
+        const Student *cur = slot->state == SLOT_FOUND ? &slot->rec : NULL;
+        if (d.items[k].tombstone) {
+            if (!cur) continue;
+            kinds[kept] = WATCH_REMOVED;
+            d.items[k].rec = *cur;
+        } else {
+            kinds[kept] = cur ? WATCH_UPDATED : WATCH_ADDED;
+        }
+        if (kept != k) memcpy(d.scores[kept], d.scores[k], sizeof(d.scores[k]));
+        d.items[kept++] = d.items[k];
+    }
+
+    for (size_t k = 0; reweigh && k < ncols; ++k) {
+        if (weights[k] != gradebook_weight(k)) gradebook_set_weight(k, weights[k]);
+    }
+    /* scores first, so the merge stores the weighted final as the grade */
+    for (size_t k = 0; ncols && k < kept; ++k) {
+        if (d.items[k].tombstone) continue;
+        for (size_t c = 0; c < ncols; ++c) gradebook_load_score(d.items[k].rec.id, c, d.scores[k][c]);
+        gradebook_final(d.items[k].rec.id, &d.items[k].rec.grade);
+    }
+    storage_merge(d.items, kept, NULL);
+    if (fn) {
+        for (size_t k = 0; k < kept; ++k) fn(kinds[k], &d.items[k].rec, user);
+    }
+    size_t changed = kept;
+    if (reweigh) {
+        Reweighed r = { &ix, fn, user, 0 };
+        storage_foreach(report_reweighed, &r);
+        changed += r.count;
+    }
+    free(ix.slots);
+    free(kinds);
+    free(d.items);
+    free(d.scores);
+    return changed;
+}
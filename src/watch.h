@@ -0,0 +1,32 @@
+#ifndef WATCH_H
+#define WATCH_H
+
+/* Watches the CSV data file with inotify and folds outside edits into the
+   in-memory roster. Only the lines that differ from the last version we
+   saw are parsed; the result is applied through storage_merge, so local
+   changes to other students survive. */
+
+#include "storage.h"
+
+typedef enum {
+    WATCH_ADDED,
+    WATCH_UPDATED,
+    WATCH_REMOVED
+} WatchChange;
+
+/* Called once per student an edit touched (after storage is updated) */
+typedef void (*watch_change_fn)(WatchChange kind, const Student *s, void *user);
+
+/* Start watching filename, taking its current content as the baseline.
+   Returns the inotify descriptor to poll for readability, or -1. */
+int watch_start(const char *filename);
+void watch_stop(void);
+/* -1 when not watching */
+int watch_fd(void);
+/* Drain pending events and apply any content change. fn may be NULL.
+   Returns the number of students changed. */
+size_t watch_poll(watch_change_fn fn, void *user);
+/* Adopt the file's current content as the baseline (after we wrote it) */
+void watch_sync(const char *filename);
+
+#endif /* WATCH_H */
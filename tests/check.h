@@ -0,0 +1,24 @@
+#ifndef CHECK_H
+#define CHECK_H
+
+/* Shared by the test programs under tests/: CHECK records a failure and
+   carries on, so one run reports every broken expectation, and main ends
+   with return check_report("test_name"). */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); failures++; } \
+} while (0)
+
+/* Exit status for main; prints "<name>: ok" when nothing failed */
+static inline int check_report(const char *name) {
+    if (failures) return EXIT_FAILURE;
+    printf("%s: ok\n", name);
+    return EXIT_SUCCESS;
+}
+
+#endif /* CHECK_H */
@@ -0,0 +1,153 @@
+/* tests/test_bptree.c — randomized inserts, removes, lookups and scans
+   against a reference, with enough keys for a tree of several levels */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bptree.h"
+#include "check.h"
+
+/* Keys are drawn from 1..KEY_SPACE; a tree of more than
+   BPT_LEAF_MAX * BPT_INNER_MAX records needs three levels */
+#define KEY_SPACE 200000
+#define FILL 60000
+
+/* Reference: present[id] says whether id is in the tree. Walking it in
+   index order gives the keys sorted. */
+static unsigned char present[KEY_SPACE + 1];
+static size_t ref_size = 0;
+
+static unsigned long long rng_state = 88172645463325252ULL;
+
+static int rand_key(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return 1 + (int)(rng_state % KEY_SPACE);
+}
+
+static Student make(int id) {
+    Student s;
+    memset(&s, 0, sizeof(s));
+    s.id = id;
+    snprintf(s.name, sizeof(s.name), "s%d", id);
+    s.grade = id * 0.5;
+    return s;
+}
+
+static int intact(const Student *s) {
+    char name[32];
+    snprintf(name, sizeof(name), "s%d", s->id);
+    return strcmp(s->name, name) == 0 && s->grade == s->id * 0.5;
+}
+
+static void insert(BPTree *t, int id) {
+    Student s = make(id);
+    CHECK(bpt_insert(t, &s) == !present[id]);
+    if (!present[id]) ref_size++;
+    present[id] = 1;
+}
+
+static void erase(BPTree *t, int id) {
+    CHECK(bpt_remove(t, id) == present[id]);
+    if (present[id]) ref_size--;
+    present[id] = 0;
+}
+
+/* Scans compare against the next present key after the last one seen */
+typedef struct {
+    int last;
+    int bad;
+} Walk;
+
+static int next_present(int after) {
+    int id = after + 1;
+    while (id <= KEY_SPACE && !present[id]) id++;
+    return id;
+}
+
+static int walk_visit(const Student *s, void *user) {
+    Walk *w = user;
+    int want = next_present(w->last);
+    if (s->id != want || !intact(s)) w->bad = 1;
+    w->last = s->id;
+    return 0;
+}
+
+static void verify(const BPTree *t) {
+    CHECK(bpt_size(t) == ref_size);
+    Walk w = { 0, 0 };
+    CHECK(bpt_foreach(t, walk_visit, &w) == ref_size);
+    CHECK(!w.bad);
+    CHECK(next_present(w.last) > KEY_SPACE);
+
+    int lookups_ok = 1;
+    for (int id = 1; id <= KEY_SPACE; ++id) {
+        const Student *s = bpt_find(t, id);
+        if (present[id] ? !(s && s->id == id && intact(s)) : s != NULL) lookups_ok = 0;
+    }
+    CHECK(lookups_ok);
+    CHECK(bpt_find(t, 0) == NULL && bpt_find(t, KEY_SPACE + 1) == NULL);
+
+    for (int i = 0; i < 20; ++i) {
+        int lo = rand_key(), hi = rand_key();
+        if (lo > hi) {
+            int tmp = lo;
+            lo = hi;
+            hi = tmp;
+        }
+        size_t want = 0;
+        for (int id = lo; id <= hi; ++id) want += present[id];
+        Walk r = { lo - 1, 0 };
+        size_t got = bpt_range(t, lo, hi, walk_visit, &r);
+        CHECK(got == want && !r.bad);
+        CHECK(got == 0 || next_present(r.last) > hi);
+    }
+}
+
+int main(void) {
+    BPTree *t = bpt_create();
+
+    /* random fill: leaf and inner splits up to three levels */
+    while (ref_size < FILL) insert(t, rand_key());
+    verify(t);
+
+    /* mixed traffic around the fill level */
+    for (int round = 0; round < 10; ++round) {
+        for (int i = 0; i < 20000; ++i) {
+            int id = rand_key();
+            if (rng_state & 1) insert(t, id);
+            else erase(t, id);
+        }
+        verify(t);
+    }
+
+    /* drain in random order: borrows, merges and the root collapsing */
+    while (ref_size > FILL / 2) erase(t, rand_key());
+    verify(t);
+    for (int id = 1; id <= KEY_SPACE; ++id) {
+        if (present[id] && rand_key() % 2) erase(t, id);
+    }
+    verify(t);
+    for (int id = KEY_SPACE; id >= 1; --id) {
+        if (present[id]) erase(t, id);
+        if (ref_size == 1000) verify(t);
+    }
+    verify(t);
+    CHECK(bpt_size(t) == 0);
+
+    /* ascending then descending runs split only at one edge */
+    for (int id = 1; id <= 5000; ++id) insert(t, id);
+    for (int id = KEY_SPACE; id > KEY_SPACE - 5000; --id) insert(t, id);
+    verify(t);
+    for (int id = 1; id <= 5000; ++id) erase(t, id);
+    verify(t);
+    bpt_clear(t);
+    memset(present, 0, sizeof(present));
+    ref_size = 0;
+    verify(t);
+
+    bpt_destroy(t);
+    return check_report("test_bptree");
+}
@@ -0,0 +1,76 @@
+/* tests/test_command.c — score and weight edits undo like any batch */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "check.h"
+#include "command.h"
+#include "gradebook.h"
+#include "storage.h"
+
+static double grade_of(int id) {
+    const Student *s = find_student(id);
+    return s ? s->grade : -1.0;
+}
+
+static void run(StorageBackend b) {
+    init_storage();
+    storage_set_backend(b);
+    storage_set_quiet(1);
+    gradebook_clear();
+    int a = add_student("Ann", 50.0);
+    int c = add_student("Cy", 60.0);
+    gradebook_add_assessment("quiz", 1.0);
+    gradebook_add_assessment("exam", 3.0);
+
+    /* both scores of Ann in one batch */
+    CHECK(command_set_score(a, 0, 40.0) == 0);
+    CHECK(command_set_score(a, 1, 80.0) == 0);
+    CHECK(command_set_score(999, 0, 10.0) != 0);
+    CHECK(command_set_score(a, 5, 10.0) != 0);
+    CHECK(command_commit(NULL) == 2);
+    CHECK(grade_of(a) == 70.0);
+
+    CHECK(command_set_weight(1, 1.0) == 0);
+    CHECK(command_set_weight(0, -1.0) != 0);
+    command_commit(NULL);
+    CHECK(grade_of(a) == 60.0);
+
+    /* a new student scored in the batch that adds it */
+    int d = command_add("Dee", 0.0);
+    CHECK(command_set_score(d, 1, 90.0) == 0);
+    command_commit(NULL);
+    CHECK(grade_of(d) == 90.0);
+
+    /* removing a student undoes with its scores and final */
+    command_remove(a);
+    command_commit(NULL);
+    CHECK(find_student(a) == NULL);
+    CHECK(command_undo() == 0);
+    CHECK(grade_of(a) == 60.0 && gradebook_score(a, 0) == 40.0);
+
+    CHECK(command_undo() == 0); /* Dee */
+    CHECK(find_student(d) == NULL);
+    CHECK(command_undo() == 0); /* the weight */
+    CHECK(gradebook_weight(1) == 3.0 && grade_of(a) == 70.0);
+    CHECK(command_undo() == 0); /* the scores */
+    CHECK(isnan(gradebook_score(a, 0)) && isnan(gradebook_score(a, 1)));
+    CHECK(command_undo() != 0);
+    CHECK(grade_of(c) == 60.0);
+
+    CHECK(command_redo() == 0);
+    CHECK(command_redo() == 0);
+    CHECK(command_redo() == 0);
+    CHECK(grade_of(a) == 60.0 && grade_of(d) == 90.0 && gradebook_score(d, 1) == 90.0);
+
+    command_reset();
+    gradebook_clear();
+    free_storage();
+}
+
+int main(void) {
+    run(STORAGE_BACKEND_ARRAY);
+    run(STORAGE_BACKEND_BPTREE);
+    return check_report("test_command");
+}
@@ -0,0 +1,70 @@
+/* tests/test_merge.c — storage_merge gives the same result on both backends */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "check.h"
+#include "storage.h"
+
+static StudentDelta row(int id, const char *name, double grade) {
+    StudentDelta d;
+    memset(&d, 0, sizeof(d));
+    d.rec.id = id;
+    strncpy(d.rec.name, name, NAME_LENGTH - 1);
+    d.rec.grade = grade;
+    return d;
+}
+
+static StudentDelta tomb(int id) {
+    StudentDelta d = row(id, "", 0.0);
+    d.tombstone = 1;
+    return d;
+}
+
+static long id_sum;
+static int sum_ids(const Student *s, void *user) {
+    (void)user;
+    id_sum += s->id;
+    return 0;
+}
+
+static void run(StorageBackend b, MergeStats *st, size_t *count, long *ids, double *grade4) {
+    init_storage();
+    storage_set_backend(b);
+    storage_set_quiet(1);
+    for (int i = 1; i <= 5; ++i) add_student("S", i * 10.0);
+    StudentDelta d[] = {
+        row(2, "Two", 1.0), tomb(2),      /* existing: update then delete */
+        tomb(3), row(3, "Three", 3.0),    /* existing: delete then update */
+        row(9, "Nine", 9.0), tomb(9),     /* new: insert then delete */
+        tomb(8), row(8, "Eight", 8.0),    /* new: delete then insert */
+        row(4, "Four", 4.0), row(4, "Four", 44.0),
+        tomb(42),                         /* never existed */
+    };
+    storage_merge(d, sizeof(d) / sizeof(d[0]), st);
+    *count = get_storage_count();
+    id_sum = 0;
+    storage_foreach(sum_ids, NULL);
+    *ids = id_sum;
+    const Student *s = find_student(4);
+    *grade4 = s ? s->grade : -1.0;
+    free_storage();
+}
+
+int main(void) {
+    MergeStats a, t;
+    size_t na, nt;
+    long ia, it;
+    double ga, gt;
+    run(STORAGE_BACKEND_ARRAY, &a, &na, &ia, &ga);
+    run(STORAGE_BACKEND_BPTREE, &t, &nt, &it, &gt);
+
+    CHECK(a.inserted == 1 && a.updated == 2 && a.deleted == 1);
+    CHECK(a.inserted == t.inserted && a.updated == t.updated && a.deleted == t.deleted);
+    CHECK(na == 5 && nt == 5);
+    CHECK(ia == 1 + 3 + 4 + 5 + 8 && it == ia);
+    CHECK(ga == 44.0 && gt == 44.0);
+
+    return check_report("test_merge");
+}
@@ -0,0 +1,146 @@
+/* tests/test_parallel.c — parallel_sort agrees with qsort and the
+   parallel grade sum with a sequential one, on four threads */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "check.h"
+#include "storage.h"
+#include "threadpool.h"
+
+/* above storage.c's PARALLEL_THRESHOLD (32768), so sorts and averages
+   take the parallel paths */
+#define N 100003
+
+static unsigned long long rng_state = 0x9e3779b97f4a7c15ULL;
+
+static unsigned rand_u(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return (unsigned)(rng_state >> 11);
+}
+
+static int cmp_int(const void *a, const void *b) {
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+/* The comparators storage.c sorts with: equal grades and names that
+   differ only in case compare as ties */
+static int cmp_grade_desc(const void *a, const void *b) {
+    const Student *sa = a;
+    const Student *sb = b;
+    if (sa->grade < sb->grade) return 1;
+    if (sa->grade > sb->grade) return -1;
+    return 0;
+}
+
+static int cmp_name(const void *a, const void *b) {
+    return strcasecmp(((const Student *)a)->name, ((const Student *)b)->name);
+}
+
+static int cmp_id(const void *a, const void *b) {
+    return cmp_int(&((const Student *)a)->id, &((const Student *)b)->id);
+}
+
+/* Ties may land in any order (neither sort is stable): the results must
+   agree key by key and hold the same records */
+static int same_sort(Student *got, Student *want, size_t n, int (*cmp)(const void *, const void *)) {
+    for (size_t i = 0; i < n; ++i) {
+        if (cmp(&got[i], &want[i]) != 0) return 0;
+    }
+    qsort(got, n, sizeof(Student), cmp_id);
+    qsort(want, n, sizeof(Student), cmp_id);
+    return memcmp(got, want, n * sizeof(Student)) == 0;
+}
+
+typedef struct {
+    Student *arr;
+    size_t n;
+} Copy;
+
+static int copy_row(const Student *s, void *user) {
+    Copy *c = user;
+    c->arr[c->n++] = *s;
+    return 0;
+}
+
+/* grades in quarter points: every partial sum is exact, so the chunked
+   parallel sum must equal the sequential one bit for bit whatever the
+   order of the roster. No grade is 0, so a row left out always shows. */
+static double expected_average(const Student *input) {
+    double seq = 0.0;
+    for (size_t i = 0; i < N; ++i) seq += input[i].grade;
+    return seq / N;
+}
+
+static void sort_storage(StorageBackend b, const Student *input) {
+    static const char *names[] = { "ann", "Ann", "bob", "BOB", "Cy", "dee", "Eve" };
+    Student *want = malloc(N * sizeof(Student));
+    Copy got = { malloc(N * sizeof(Student)), 0 };
+    init_storage();
+    storage_set_backend(b);
+    storage_set_quiet(1);
+    for (size_t i = 0; i < N; ++i) add_student(names[i % 7], input[i].grade);
+    CHECK(compute_average() == expected_average(input));
+
+    sort_by_grade_desc();
+    storage_foreach(copy_row, &got);
+    CHECK(got.n == N);
+    memcpy(want, got.arr, N * sizeof(Student));
+    qsort(want, N, sizeof(Student), cmp_grade_desc);
+    CHECK(same_sort(got.arr, want, N, cmp_grade_desc));
+
+    /* a sorted roster is summed in parallel on both backends */
+    CHECK(compute_average() == expected_average(input));
+
+    sort_by_name();
+    got.n = 0;
+    storage_foreach(copy_row, &got);
+    memcpy(want, got.arr, N * sizeof(Student));
+    qsort(want, N, sizeof(Student), cmp_name);
+    CHECK(same_sort(got.arr, want, N, cmp_name));
+    CHECK(compute_average() == expected_average(input));
+
+    free_storage();
+    free(want);
+    free(got.arr);
+}
+
+int main(void) {
+    setenv("GRADE_THREADS", "4", 1);
+    CHECK(pool_thread_count() == 4);
+
+    /* plain keys with many duplicates: equal ints are indistinguishable,
+       so the outputs must match exactly */
+    int *a = malloc(N * sizeof(int)), *b = malloc(N * sizeof(int));
+    for (size_t i = 0; i < N; ++i) a[i] = b[i] = (int)(rand_u() % 1000) - 500;
+    parallel_sort(a, N, sizeof(int), cmp_int);
+    qsort(b, N, sizeof(int), cmp_int);
+    CHECK(memcmp(a, b, N * sizeof(int)) == 0);
+    /* already sorted and reversed input */
+    parallel_sort(a, N, sizeof(int), cmp_int);
+    CHECK(memcmp(a, b, N * sizeof(int)) == 0);
+    for (size_t i = 0; i < N / 2; ++i) {
+        int t = a[i];
+        a[i] = a[N - 1 - i];
+        a[N - 1 - i] = t;
+    }
+    parallel_sort(a, N, sizeof(int), cmp_int);
+    CHECK(memcmp(a, b, N * sizeof(int)) == 0);
+    free(a);
+    free(b);
+
+    Student *input = malloc(N * sizeof(Student));
+    for (size_t i = 0; i < N; ++i) input[i].grade = (double)(rand_u() % 400 + 1) / 4.0;
+    sort_storage(STORAGE_BACKEND_ARRAY, input);
+    sort_storage(STORAGE_BACKEND_BPTREE, input);
+    free(input);
+
+    pool_shutdown();
+    return check_report("test_parallel");
+}
@@ -0,0 +1,128 @@
+/* tests/test_shards.c — a failed sharded load must not be saved over, and
+   assessment scores survive a sharded save and load */
+
+#define _POSIX_C_SOURCE 200809L
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "check.h"
+#include "command.h"
+#include "csv.h"
+#include "gradebook.h"
+#include "storage.h"
+#include "threadpool.h"
+
+static char *slurp(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    static char buf[1 << 16];
+    size_t n = fread(buf, 1, sizeof(buf) - 1, f);
+    fclose(f);
+    buf[n] = '\0';
+    return strdup(buf);
+}
+
+static void put(const char *path, const char *text) {
+    FILE *f = fopen(path, "wb");
+    fputs(text, f);
+    fclose(f);
+}
+
+/* Load the set, which must fail, then save: every file must be unchanged */
+static void check_untouched(const char *file, const char *manifest, const char *shard0) {
+    char *m0 = slurp(manifest), *s0 = slurp(shard0);
+    init_storage();
+    load_from_file(file);
+    CHECK(get_storage_count() == 0);
+    add_student("Edited after the failed load", 50.0);
+    save_to_file(file);
+    char *m1 = slurp(manifest), *s1 = slurp(shard0);
+    CHECK(m1 && strcmp(m0, m1) == 0);
+    CHECK(s1 && strcmp(s0, s1) == 0);
+    free_storage();
+    free(m0);
+    free(m1);
+    free(s0);
+    free(s1);
+}
+
+int main(void) {
+    char dir[] = "/tmp/test_shardsXXXXXX";
+    if (!mkdtemp(dir)) return EXIT_FAILURE;
+    char file[256], manifest[300], shard0[300], shard1[300];
+    snprintf(file, sizeof(file), "%s/students.csv", dir);
+    snprintf(manifest, sizeof(manifest), "%s.manifest", file);
+    snprintf(shard0, sizeof(shard0), "%s.1.0", file);
+    snprintf(shard1, sizeof(shard1), "%s.1.1", file);
+    setenv("GRADE_SHARDS", "2", 1);
+    storage_set_quiet(1);
+
+    init_storage();
+    for (int i = 0; i < 10; ++i) add_student("Student", 60.0 + i);
+    save_to_file(file);
+    free_storage();
+
+    /* a shard that fails its checksum */
+    char *good = slurp(shard1);
+    CHECK(good != NULL);
+    char *bad = strdup(good);
+    bad[0] = bad[0] == '9' ? '8' : '9';
+    put(shard1, bad);
+    check_untouched(file, manifest, shard0);
+
+    /* a malformed manifest: generation 1 must not be rewritten */
+    put(shard1, good);
+    char *m = slurp(manifest);
+    put(manifest, "not a manifest\n");
+    check_untouched(file, manifest, shard0);
+
+    /* once the set loads again, saving works */
+    put(manifest, m);
+    init_storage();
+    load_from_file(file);
+    CHECK(get_storage_count() == 10);
+    save_to_file(file);
+    char *m2 = slurp(manifest);
+    CHECK(m2 && strstr(m2, "generation 2") != NULL);
+    free_storage();
+
+    /* a set without assessments clears the ones in memory */
+    init_storage();
+    gradebook_add_assessment("Stale", 1.0);
+    load_from_file(file);
+    CHECK(gradebook_count() == 0);
+
+    /* scores and weights go through the manifest and shard rows */
+    CHECK(gradebook_add_assessment("Midterm", 0.25) == 0);
+    CHECK(gradebook_add_assessment("Final exam", 0.75) == 1);
+    CHECK(command_set_score(3, 0, 40.0) == 0);
+    CHECK(command_set_score(3, 1, 80.0) == 0);
+    CHECK(command_set_score(8, 1, 55.5) == 0);
+    command_commit(NULL);
+    save_to_file(file);
+    free_storage();
+    init_storage();
+    load_from_file(file);
+    CHECK(gradebook_count() == 2);
+    CHECK(strcmp(gradebook_name(1), "Final exam") == 0 && gradebook_weight(1) == 0.75);
+    CHECK(gradebook_score(3, 0) == 40.0 && gradebook_score(3, 1) == 80.0);
+    CHECK(isnan(gradebook_score(8, 0)) && gradebook_score(8, 1) == 55.5);
+    CHECK(find_student(3) && find_student(3)->grade == 70.0);
+    CHECK(find_student(8) && find_student(8)->grade == 55.5);
+    CHECK(find_student(5) && find_student(5)->grade == 64.0);
+    free_storage();
+
+    free(good);
+    free(bad);
+    free(m);
+    free(m2);
+    command_reset();
+    pool_shutdown();
+    char cmd[300];
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+    if (system(cmd) != 0) failures++;
+    return check_report("test_shards");
+}